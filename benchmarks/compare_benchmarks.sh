@@ -0,0 +1,62 @@
+#!/bin/bash
+
+# compare_benchmarks.sh
+# Compares a benchmark report from run_benchmarks.sh against a baseline report,
+# and flags any case which has got slower or uses more memory or disk space by
+# more than a relative tolerance. It takes three inputs:
+# Input 1: Benchmark report
+# Input 2: Baseline report
+# Input 3: Relative tolerance (default 0.1, i.e. 10%)
+# Exits with 1 if there are any regressions, so it can be used in scripts.
+
+REPORT=$1
+BASELINE=$2
+TOLERANCE=${3:-0.1}
+
+awk -F ',' -v tol=$TOLERANCE '
+    # Reads the baseline into arrays indexed by case name
+    FNR == 1 { next }
+    FNR == NR {
+        cps[$1] = $5; tps[$1] = $6; rss[$1] = $7; bytes[$1] = $8
+        next
+    }
+
+    # Checks that a quantity has not increased by more than the tolerance
+    function check(name, quantity, new, old) {
+        if (old == "" || old == 0 || new == "") return 0
+        change = (new - old) / old
+        printf "    %-16s %12g -> %12g (%+.1f%%)\n", quantity, old, new, \
+            100 * change
+        if (change > tol) {
+            printf "    REGRESSION: %s of %s increased by more than %g%%\n", \
+                quantity, name, 100 * tol
+            return 1
+        }
+        return 0
+    }
+
+    {
+        if (!($1 in cps)) {
+            printf "%s: not in baseline\n", $1
+            next
+        }
+        if ($5 == "") {
+            printf "%s: did not finish\n", $1
+            regressions++
+            next
+        }
+        printf "%s:\n", $1
+        # A drop in cells per second is checked as an increase in its inverse
+        regressions += check($1, "seconds/cell", 1 / $5, 1 / cps[$1])
+        regressions += check($1, "time/step", $6, tps[$1])
+        regressions += check($1, "peak RSS (kB)", $7, rss[$1])
+        regressions += check($1, "output bytes", $8, bytes[$1])
+    }
+
+    END {
+        if (regressions > 0) {
+            printf "%d performance regressions found\n", regressions
+            exit 1
+        }
+        print "No performance regressions found"
+    }' $BASELINE $REPORT
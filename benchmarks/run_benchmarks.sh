@@ -0,0 +1,69 @@
+#!/bin/bash
+
+# run_benchmarks.sh
+# Runs the benchmark cases listed in cases.txt and records their performance
+# in a report, which is then compared against the stored baseline (if there is
+# one) using compare_benchmarks.sh. It takes three inputs:
+# Input 1: Directory to run the benchmarks in (preferably on scratch)
+# Input 2: Number of threads to run each case on (default 1)
+# Input 3: Name of the report file (default benchmark_report.csv)
+# The report has one line per case with the columns
+# case, steps, cell_updates, wall_time, cells_per_second, time_per_step,
+# peak_rss_kb, output_bytes
+# To make the report the new baseline, copy it to baseline.csv in this 
+# directory. Baselines are only meaningful on the machine they were made on.
+
+BENCH_DIR=$(realpath $1)
+CORES=${2:-1}
+REPORT=$(realpath ${3:-benchmark_report.csv})
+
+# Directories of the benchmark scripts and utility scripts
+SCRIPT_DIR=$(dirname $(realpath $0))
+UTILITY_DIR=$SCRIPT_DIR/../utility_scripts
+
+# Benchmarks must always run, so the result cache is turned off
+export RESULT_CACHE=0
+
+mkdir -p $BENCH_DIR
+echo "case,steps,cell_updates,wall_time,cells_per_second,time_per_step,peak_rss_kb,output_bytes" \
+    > $REPORT
+
+# Loops over all of the non-comment lines in the cases file
+grep -v '^#' $SCRIPT_DIR/cases.txt | while read CASE PARAMETERS
+do
+    echo Running benchmark $CASE
+
+    # Copies the code and sets the parameters of the case
+    rm -rf $BENCH_DIR/$CASE
+    cd $UTILITY_DIR
+    ./code_copy.sh ../droplet_impact_plate $BENCH_DIR $CASE
+    ./set_parameters.sh $BENCH_DIR/$CASE/code/parameters.h $PARAMETERS
+
+    # Runs the case
+    cd $BENCH_DIR/$CASE/code
+    ./run_simulation.sh droplet_impact_plate $CORES > /dev/null 2>&1
+
+    # Reads the performance summary written to the log at the end of the run
+    SUMMARY=$(grep "^Performance:" $BENCH_DIR/$CASE/raw_data/log)
+    if [ -z "$SUMMARY" ]; then
+        echo "Benchmark $CASE did not finish"
+        echo "$CASE,,,,,,," >> $REPORT
+        continue
+    fi
+    OUTPUT_BYTES=$(du -sb $BENCH_DIR/$CASE/raw_data | cut -f 1)
+
+    echo "$SUMMARY" | sed 's/[a-z_]* = //g; s/Performance: //' \
+        | awk -F ', ' -v name=$CASE -v bytes=$OUTPUT_BYTES '{
+            printf "%s,%d,%d,%g,%g,%g,%d,%d\n", name, $1, $2, $3, \
+                $2 / $3, $3 / $1, $4, bytes
+        }' >> $REPORT
+done
+
+echo Written benchmark report to $REPORT
+
+# Compares against the baseline
+if [ -f $SCRIPT_DIR/baseline.csv ]; then
+    $SCRIPT_DIR/compare_benchmarks.sh $REPORT $SCRIPT_DIR/baseline.csv
+else
+    echo "No baseline.csv in $SCRIPT_DIR, copy the report there to create one"
+fi
@@ -0,0 +1,190 @@
+/* run_archive_tool.c
+    Tool for the run archives run.rca written with ARCHIVE_OUTPUT, see 
+    droplet_impact_plate/code/run_archive.h for the format.
+
+    Usage:
+    ./run_archive_tool list ARCHIVE
+        Prints each file in the archive with its size, number of chunks and
+        the simulation time it was last written
+    ./run_archive_tool extract [-o DIR] ARCHIVE [NAME ...]
+        Writes the named files (or all of them) into DIR, which defaults to
+        the directory of the archive, giving the same files as a run without
+        ARCHIVE_OUTPUT
+    ./run_archive_tool pack [-r] DIR ARCHIVE
+        Adds the output files in the directory DIR of an existing run to the
+        archive, apart from the log, movies and the archive itself. With -r
+        the files are removed once they are in the archive
+*/
+
+#include "run_archive.h"
+#include <dirent.h>
+#include <libgen.h>
+#include <sys/stat.h>
+
+/* Names of the distinct files in the archive, in the order they first
+appear */
+static int file_names(const run_archive * a, const char *** names) {
+    int n = 0;
+    *names = malloc((a->entry_no + 1) * sizeof(char *));
+    for (int k = 0; k < a->entry_no; k++) {
+        int seen = 0;
+        for (int j = 0; j < n && !seen; j++) {
+            seen = !strcmp((*names)[j], a->entries[k].name);
+        }
+        if (!seen) (*names)[n++] = a->entries[k].name;
+    }
+    return n;
+}
+
+static int list(int argc, char * argv[]) {
+    if (argc != 3) {
+        fprintf(stderr, "Usage: %s list ARCHIVE\n", argv[0]);
+        return 1;
+    }
+    run_archive a;
+    if (archive_open(&a, argv[2], 0) < 0) {
+        fprintf(stderr, "Could not open %s\n", argv[2]);
+        return 1;
+    }
+    const char ** names;
+    int n = file_names(&a, &names);
+    printf("# name, size, chunks, t\n");
+    for (int j = 0; j < n; j++) {
+        long size = 0;
+        int chunks = 0;
+        double t = 0.;
+        for (int k = archive_find(&a, names[j]); k < a.entry_no; k++) {
+            if (strcmp(a.entries[k].name, names[j])) continue;
+            size += a.entries[k].size;
+            chunks++;
+            t = a.entries[k].t;
+        }
+        printf("%s, %ld, %d, %g\n", names[j], size, chunks, t);
+    }
+    free(names);
+    archive_close(&a, 0.);
+    return 0;
+}
+
+static int extract(int argc, char * argv[]) {
+    const char * out_dir = NULL;
+    int first = 2;
+    if (argc > 3 && !strcmp(argv[2], "-o")) {
+        out_dir = argv[3];
+        first = 4;
+    }
+    if (argc <= first) {
+        fprintf(stderr, "Usage: %s extract [-o DIR] ARCHIVE [NAME ...]\n", \
+            argv[0]);
+        return 1;
+    }
+    const char * archive_name = argv[first];
+    run_archive a;
+    if (archive_open(&a, archive_name, 0) < 0) {
+        fprintf(stderr, "Could not open %s\n", archive_name);
+        return 1;
+    }
+
+    char archive_dir[ARCHIVE_NAME_LENGTH];
+    snprintf(archive_dir, sizeof(archive_dir), "%s", archive_name);
+    if (out_dir == NULL) out_dir = dirname(archive_dir);
+    mkdir(out_dir, 0755);
+
+    const char ** names;
+    int n = argc > first + 1 ? argc - first - 1 : file_names(&a, &names);
+    if (argc > first + 1) names = (const char **) &argv[first + 1];
+
+    int failures = 0;
+    for (int j = 0; j < n; j++) {
+        char path[2 * ARCHIVE_NAME_LENGTH];
+        snprintf(path, sizeof(path), "%s/%s", out_dir, names[j]);
+        FILE * fp = fopen(path, "wb");
+        if (fp == NULL || archive_extract(&a, names[j], fp) < 0) {
+            fprintf(stderr, "Could not extract %s\n", names[j]);
+            failures++;
+        }
+        if (fp != NULL) fclose(fp);
+    }
+    printf("Extracted %d files into %s\n", n - failures, out_dir);
+    if (argc == first + 1) free(names);
+    archive_close(&a, 0.);
+    return failures > 0;
+}
+
+/* Files of a run which are not put in the archive by the simulation */
+static int is_packed(const char * name, const char * archive_name) {
+    size_t length = strlen(name);
+    if (!strcmp(name, "log") || !strcmp(name, archive_name)) return 0;
+    if (!strcmp(name, "metrics.prom")) return 0;
+    return !(length > 4 && !strcmp(name + length - 4, ".mp4"));
+}
+
+static int pack(int argc, char * argv[]) {
+    int remove_files = argc > 2 && !strcmp(argv[2], "-r");
+    int first = remove_files ? 3 : 2;
+    if (argc != first + 2) {
+        fprintf(stderr, "Usage: %s pack [-r] DIR ARCHIVE\n", argv[0]);
+        return 1;
+    }
+    const char * dir_name = argv[first];
+    const char * archive_name = argv[first + 1];
+    DIR * dir = opendir(dir_name);
+    run_archive a;
+    if (dir == NULL || archive_open(&a, archive_name, 1) < 0) {
+        fprintf(stderr, "Could not open %s or %s\n", dir_name, archive_name);
+        return 1;
+    }
+    char archive_base[ARCHIVE_NAME_LENGTH];
+    snprintf(archive_base, sizeof(archive_base), "%s", archive_name);
+
+    int packed = 0, failures = 0;
+    struct dirent * file;
+    while ((file = readdir(dir)) != NULL) {
+        char path[2 * ARCHIVE_NAME_LENGTH];
+        struct stat st;
+        snprintf(path, sizeof(path), "%s/%s", dir_name, file->d_name);
+        if (stat(path, &st) < 0 || !S_ISREG(st.st_mode) \
+                || !is_packed(file->d_name, basename(archive_base))) {
+            continue;
+        }
+        FILE * fp = fopen(path, "rb");
+        char * data = malloc(st.st_size + 1);
+        if (fp == NULL || fread(data, 1, st.st_size, fp) != (size_t) st.st_size \
+                || archive_add(&a, file->d_name, ARCHIVE_WRITE, 0., data, \
+                    st.st_size) < 0) {
+            fprintf(stderr, "Could not pack %s\n", path);
+            failures++;
+        } else {
+            packed++;
+        }
+        if (fp != NULL) fclose(fp);
+        free(data);
+    }
+    closedir(dir);
+    archive_close(&a, 0.);
+
+    // Files are only removed once the archive has been closed successfully
+    if (remove_files && failures == 0) {
+        dir = opendir(dir_name);
+        while ((file = readdir(dir)) != NULL) {
+            char path[2 * ARCHIVE_NAME_LENGTH];
+            struct stat st;
+            snprintf(path, sizeof(path), "%s/%s", dir_name, file->d_name);
+            if (stat(path, &st) == 0 && S_ISREG(st.st_mode) \
+                    && is_packed(file->d_name, basename(archive_base))) {
+                remove(path);
+            }
+        }
+        closedir(dir);
+    }
+    printf("Packed %d files into %s\n", packed, archive_name);
+    return failures > 0;
+}
+
+int main(int argc, char * argv[]) {
+    if (argc > 1 && !strcmp(argv[1], "list")) return list(argc, argv);
+    if (argc > 1 && !strcmp(argv[1], "extract")) return extract(argc, argv);
+    if (argc > 1 && !strcmp(argv[1], "pack")) return pack(argc, argv);
+    fprintf(stderr, "Usage: %s list|extract|pack ...\n", argv[0]);
+    return 1;
+}
@@ -0,0 +1,312 @@
+/* plate_screening.c
+    Fast one-way coupled estimate of the plate response for many plate
+    parameters. Reads the force trace of a single simulation (usually a 
+    stationary plate run) and integrates the plate ODE
+        ALPHA s''(t) + BETA s'(t) + GAMMA s(t) = F(t)
+    with the same second-order explicit scheme as the moving_plate event of
+    droplet_impact_plate.c, for every combination of (ALPHA, BETA, GAMMA). 
+    This is only valid in the weakly coupled regime, where the plate motion
+    does not change the force, so for each combination the maximum plate
+    velocity is reported to flag where a full simulation is needed.
+
+    The combinations are integrated in batches of BATCH_SIZE, stored as arrays
+    so the inner loop over a batch vectorises, with the batches distributed 
+    over threads using OpenMP.
+
+    Usage:
+    ./plate_screening [options] FORCE_FILE
+    where FORCE_FILE is either the log of a run or the cleaned output.txt. 
+    Options:
+    -a MIN MAX N    Range of ALPHA values (default 2 2 1)
+    -b MIN MAX N    Range of BETA values (default 0 0 1)
+    -g MIN MAX N    Range of GAMMA values (default 0 0 1)
+    -l RANGES       Space the values of the given ranges logarithmically,
+                    e.g. -l ag for ALPHA and GAMMA. Their bounds must be
+                    positive
+    -p FILE         Read the combinations from FILE (lines of ALPHA BETA GAMMA)
+                    instead of the ranges
+    -c COLUMN       Column of the force in FORCE_FILE (default 2, i.e. F)
+    -d DT           Timestep of the ODE (default 1e-4, as in the simulations)
+    -o FILE         Output file for the peak diagnostics (default stdout)
+    -s FILE         Also write s(t) for every combination to FILE
+    -v THRESHOLD    Maximum plate velocity |s'| above which the combination is
+                    flagged as coupled (default 0.1)
+*/
+
+#include "run_reader.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define BATCH_SIZE 256 // Number of combinations integrated together
+
+/* Plate parameters and the resulting diagnostics */
+typedef struct {
+    double alpha, beta, gamma;
+    double s_max, t_s_max; // Maximum displacement and when it occurs
+    double s_min, t_s_min; // Minimum displacement and when it occurs
+    double sdot_max; // Maximum plate speed |s'|
+    double sddot_max; // Maximum plate acceleration |s''|
+    double s_final; // Displacement at the end of the trace
+} combination;
+
+/* Values of a range, either linearly or logarithmically spaced */
+static double range_value(const double * range, int k, int log_spacing) {
+    int n = (int) range[2];
+    if (n <= 1) return range[0];
+    double w = (double) k / (n - 1);
+    if (log_spacing) {
+        return exp((1 - w) * log(range[0]) + w * log(range[1]));
+    }
+    return (1 - w) * range[0] + w * range[1];
+}
+
+/* Force interpolated linearly from the trace at time t */
+static double force_at(const double * times, const double * forces, \
+        size_t n, double t, size_t * index) {
+    while (*index + 1 < n && times[*index + 1] <= t) (*index)++;
+    if (*index + 1 >= n) return forces[n - 1];
+    double w = (t - times[*index]) / (times[*index + 1] - times[*index]);
+    return (1 - w) * forces[*index] + w * forces[*index + 1];
+}
+
+/* Integrates the batch of combinations [start, end) over the force trace.
+If trace is not NULL, s at step k of combination j is stored in 
+trace[k * total + j] */
+static void integrate_batch(combination * combinations, int start, int end, \
+        const double * times, const double * forces, size_t n, double dt, \
+        int steps, double * trace, int total) {
+    int m = end - start;
+    double alpha[BATCH_SIZE], beta[BATCH_SIZE], gamma[BATCH_SIZE];
+    double s_previous[BATCH_SIZE], s_current[BATCH_SIZE];
+    double s_max[BATCH_SIZE], t_s_max[BATCH_SIZE];
+    double s_min[BATCH_SIZE], t_s_min[BATCH_SIZE];
+    double sdot_max[BATCH_SIZE], sddot_max[BATCH_SIZE];
+
+    for (int j = 0; j < m; j++) {
+        alpha[j] = combinations[start + j].alpha;
+        beta[j] = combinations[start + j].beta;
+        gamma[j] = combinations[start + j].gamma;
+        s_previous[j] = s_current[j] = 0.;
+        s_max[j] = s_min[j] = 0.;
+        t_s_max[j] = t_s_min[j] = times[0];
+        sdot_max[j] = sddot_max[j] = 0.;
+    }
+
+    size_t index = 0;
+    for (int k = 0; k < steps; k++) {
+        double t = times[0] + k * dt;
+        double force = force_at(times, forces, n, t, &index);
+
+        #pragma omp simd
+        for (int j = 0; j < m; j++) {
+            double s_next = (dt * dt * force \
+                + (2. * alpha[j] - dt * dt * gamma[j]) * s_current[j] \
+                - (alpha[j] - dt * beta[j] / 2.) * s_previous[j]) \
+                / (alpha[j] + dt * beta[j] / 2.);
+            double sdot = fabs(s_next - s_previous[j]) / (2. * dt);
+            double sddot = fabs(s_next - 2. * s_current[j] + s_previous[j]) \
+                / (dt * dt);
+            sdot_max[j] = sdot > sdot_max[j] ? sdot : sdot_max[j];
+            sddot_max[j] = sddot > sddot_max[j] ? sddot : sddot_max[j];
+            if (s_next > s_max[j]) {
+                s_max[j] = s_next;
+                t_s_max[j] = t + dt;
+            }
+            if (s_next < s_min[j]) {
+                s_min[j] = s_next;
+                t_s_min[j] = t + dt;
+            }
+            s_previous[j] = s_current[j];
+            s_current[j] = s_next;
+        }
+
+        if (trace != NULL) {
+            for (int j = 0; j < m; j++) {
+                trace[(size_t) k * total + start + j] = s_current[j];
+            }
+        }
+    }
+
+    for (int j = 0; j < m; j++) {
+        combination * c = &combinations[start + j];
+        c->s_max = s_max[j];
+        c->t_s_max = t_s_max[j];
+        c->s_min = s_min[j];
+        c->t_s_min = t_s_min[j];
+        c->sdot_max = sdot_max[j];
+        c->sddot_max = sddot_max[j];
+        c->s_final = s_current[j];
+    }
+}
+
+int main(int argc, char * argv[]) {
+    /* Default options */
+    double ranges[3][3] = {{2., 2., 1.}, {0., 0., 1.}, {0., 0., 1.}};
+    int log_spacing[3] = {0, 0, 0};
+    int force_column = 2;
+    double dt = 1e-4;
+    double velocity_threshold = 0.1;
+    const char * combination_filename = NULL;
+    const char * output_filename = NULL;
+    const char * trace_filename = NULL;
+    const char * force_filename = NULL;
+
+    /* Reads the options */
+    for (int k = 1; k < argc; k++) {
+        const char * option = argv[k];
+        if (option[0] == '-' && strchr("abg", option[1]) && k + 3 < argc) {
+            int r = option[1] == 'a' ? 0 : (option[1] == 'b' ? 1 : 2);
+            for (int j = 0; j < 3; j++) ranges[r][j] = atof(argv[++k]);
+        } else if (!strcmp(option, "-l") && k + 1 < argc) {
+            const char * letters = argv[++k];
+            if ((letters[0] == '\0') \
+                    || (strspn(letters, "abg") != strlen(letters))) {
+                fprintf(stderr, "-l takes the ranges to space, e.g. -l ag\n");
+                return 1;
+            }
+            for (int r = 0; r < 3; r++) {
+                if (strchr(letters, "abg"[r])) log_spacing[r] = 1;
+            }
+        } else if (!strcmp(option, "-p") && k + 1 < argc) {
+            combination_filename = argv[++k];
+        } else if (!strcmp(option, "-c") && k + 1 < argc) {
+            force_column = atoi(argv[++k]);
+        } else if (!strcmp(option, "-d") && k + 1 < argc) {
+            dt = atof(argv[++k]);
+        } else if (!strcmp(option, "-o") && k + 1 < argc) {
+            output_filename = argv[++k];
+        } else if (!strcmp(option, "-s") && k + 1 < argc) {
+            trace_filename = argv[++k];
+        } else if (!strcmp(option, "-v") && k + 1 < argc) {
+            velocity_threshold = atof(argv[++k]);
+        } else if (option[0] != '-') {
+            force_filename = option;
+        } else {
+            fprintf(stderr, "Unknown option %s\n", option);
+            return 1;
+        }
+    }
+    if (force_filename == NULL) {
+        fprintf(stderr, "Usage: %s [options] FORCE_FILE\n", argv[0]);
+        return 1;
+    }
+
+    /* Reads the force trace, from either a log file or a cleaned log */
+    rr_table table;
+    if (rr_read_log(force_filename, &table) < 0) {
+        fprintf(stderr, "Could not read %s\n", force_filename);
+        return 1;
+    }
+    if (table.rows == 0) {
+        rr_free_table(&table);
+        rr_read_field(force_filename, &table);
+    }
+    if (table.rows < 2 || force_column < 1 || force_column > table.cols) {
+        fprintf(stderr, "No force trace in column %d of %s\n", \
+            force_column, force_filename);
+        return 1;
+    }
+    size_t n = table.rows;
+    double * times = malloc(n * sizeof(double));
+    double * forces = malloc(n * sizeof(double));
+    for (size_t k = 0; k < n; k++) {
+        times[k] = table.data[k * table.cols];
+        forces[k] = table.data[k * table.cols + force_column - 1];
+    }
+    rr_free_table(&table);
+    int steps = (int) floor((times[n - 1] - times[0]) / dt);
+
+    /* Sets up the combinations of parameters */
+    int total = 0;
+    combination * combinations = NULL;
+    if (combination_filename != NULL) {
+        FILE * fp = fopen(combination_filename, "r");
+        if (fp == NULL) {
+            fprintf(stderr, "Could not read %s\n", combination_filename);
+            return 1;
+        }
+        double a, b, g;
+        int capacity = 0;
+        while (fscanf(fp, "%lf %lf %lf", &a, &b, &g) == 3) {
+            if (total == capacity) {
+                capacity = capacity ? 2 * capacity : 1024;
+                combinations \
+                    = realloc(combinations, capacity * sizeof(combination));
+            }
+            combinations[total].alpha = a;
+            combinations[total].beta = b;
+            combinations[total].gamma = g;
+            total++;
+        }
+        fclose(fp);
+    } else {
+        for (int r = 0; r < 3; r++) {
+            if (log_spacing[r] && (ranges[r][0] <= 0. || ranges[r][1] <= 0.)) {
+                fprintf(stderr, "The bounds of -%c must be positive to be "
+                    "spaced logarithmically\n", "abg"[r]);
+                return 1;
+            }
+        }
+        int na = (int) ranges[0][2], nb = (int) ranges[1][2];
+        int ng = (int) ranges[2][2];
+        total = na * nb * ng;
+        combinations = malloc(total * sizeof(combination));
+        for (int ia = 0; ia < na; ia++) {
+            for (int ib = 0; ib < nb; ib++) {
+                for (int ig = 0; ig < ng; ig++) {
+                    combination * c = &combinations[(ia * nb + ib) * ng + ig];
+                    c->alpha = range_value(ranges[0], ia, log_spacing[0]);
+                    c->beta = range_value(ranges[1], ib, log_spacing[1]);
+                    c->gamma = range_value(ranges[2], ig, log_spacing[2]);
+                }
+            }
+        }
+    }
+
+    /* Integrates all of the combinations in parallel batches */
+    double * trace = NULL;
+    if (trace_filename != NULL) {
+        trace = malloc((size_t) steps * total * sizeof(double));
+    }
+    int batch_no = (total + BATCH_SIZE - 1) / BATCH_SIZE;
+    #pragma omp parallel for schedule(dynamic)
+    for (int batch = 0; batch < batch_no; batch++) {
+        int start = batch * BATCH_SIZE;
+        int end = start + BATCH_SIZE < total ? start + BATCH_SIZE : total;
+        integrate_batch(combinations, start, end, times, forces, n, dt, \
+            steps, trace, total);
+    }
+
+    /* Outputs the peak diagnostics */
+    FILE * output = output_filename ? fopen(output_filename, "w") : stdout;
+    fprintf(output, "# ALPHA, BETA, GAMMA, s_max, t_s_max, s_min, t_s_min, sdot_max, sddot_max, s_final, coupled\n");
+    for (int j = 0; j < total; j++) {
+        combination * c = &combinations[j];
+        fprintf(output, "%g, %g, %g, %g, %g, %g, %g, %g, %g, %g, %d\n", \
+            c->alpha, c->beta, c->gamma, c->s_max, c->t_s_max, c->s_min, \
+            c->t_s_min, c->sdot_max, c->sddot_max, c->s_final, \
+            c->sdot_max > velocity_threshold);
+    }
+    if (output != stdout) fclose(output);
+
+    /* Outputs s(t), with one row per time and one column per combination */
+    if (trace != NULL) {
+        FILE * fp = fopen(trace_filename, "w");
+        for (int k = 0; k < steps; k++) {
+            fprintf(fp, "%g", times[0] + (k + 1) * dt);
+            for (int j = 0; j < total; j++) {
+                fprintf(fp, ", %g", trace[(size_t) k * total + j]);
+            }
+            fprintf(fp, "\n");
+        }
+        fclose(fp);
+        free(trace);
+    }
+
+    free(combinations);
+    free(times);
+    free(forces);
+    return 0;
+}
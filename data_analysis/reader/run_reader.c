@@ -0,0 +1,540 @@
+/* run_reader.c
+    Implementation of the run output reader library, see run_reader.h
+*/
+
+#include "run_reader.h"
+#include "field_codec.h"
+#include "tracers.h"
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Kinds of output file */
+enum { LOG_FILE, PLATE_FILE, INTERFACE_FILE, FIELD_FILE, COMPRESSED_FILE };
+
+/* Values and names parsed from one line of a file */
+typedef struct {
+    int n; // Number of values on the line
+    double values[RR_MAX_COLUMNS];
+    char names[RR_MAX_COLUMNS][RR_NAME_LENGTH];
+} line_values;
+
+
+/* Memory-mapped file */
+typedef struct {
+    const char * start;
+    const char * end;
+    size_t size;
+} mapped_file;
+
+static int map_file(const char * filename, mapped_file * file) {
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return -1;
+    }
+    file->size = st.st_size;
+
+    // Empty files cannot be mapped, but are valid (empty) outputs
+    if (file->size == 0) {
+        file->start = file->end = NULL;
+        close(fd);
+        return 0;
+    }
+
+    void * mapping = mmap(NULL, file->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) return -1;
+    madvise(mapping, file->size, MADV_SEQUENTIAL);
+
+    file->start = mapping;
+    file->end = file->start + file->size;
+    return 0;
+}
+
+static void unmap_file(mapped_file * file) {
+    if (file->size > 0) munmap((void *) file->start, file->size);
+}
+
+
+/* Parsing of lines */
+static int is_name_char(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' \
+        || (c >= '0' && c <= '9') || c == '.';
+}
+
+static int starts_number(const char * p, const char * end) {
+    if (*p >= '0' && *p <= '9') return 1;
+    if ((*p == '-' || *p == '+' || *p == '.') && p + 1 < end) {
+        return starts_number(p + 1, end);
+    }
+    return 0;
+}
+
+/* Parses all of the numbers on the line [p, end) into values. Text of the form
+"name = number" labels the number with the name, and a header of the form
+"# 1:x 2:y" (as written by output_field) labels the columns directly */
+static void parse_line(const char * p, const char * end, line_values * line) {
+    char name[RR_NAME_LENGTH] = "";
+    line->n = 0;
+
+    // Header line of output_field
+    if (p < end && *p == '#') {
+        while (p < end && line->n < RR_MAX_COLUMNS) {
+            while (p < end && *p != ':') p++;
+            if (p == end) break;
+            const char * q = ++p;
+            while (p < end && is_name_char(*p)) p++;
+            size_t length = p - q < RR_NAME_LENGTH ? p - q : RR_NAME_LENGTH - 1;
+            memcpy(line->names[line->n], q, length);
+            line->names[line->n][length] = '\0';
+            line->values[line->n++] = NAN;
+        }
+        line->n = -line->n; // Negative count marks a header line
+        return;
+    }
+
+    while (p < end && line->n < RR_MAX_COLUMNS) {
+        if (starts_number(p, end)) {
+            // Copies the number into a terminated buffer, as the mapping is not
+            // null-terminated
+            char buffer[64];
+            size_t length = 0;
+            while (p < end && length < sizeof(buffer) - 1 \
+                && (is_name_char(*p) || *p == '-' || *p == '+')) {
+                buffer[length++] = *p++;
+            }
+            buffer[length] = '\0';
+            line->values[line->n] = strtod(buffer, NULL);
+            strcpy(line->names[line->n], name);
+            line->n++;
+            name[0] = '\0';
+        } else if (is_name_char(*p)) {
+            // Reads a name, which labels the next number if followed by "="
+            const char * q = p;
+            while (p < end && is_name_char(*p)) p++;
+            size_t length = p - q < RR_NAME_LENGTH ? p - q : RR_NAME_LENGTH - 1;
+            if ((length == 3 && !strncmp(q, "nan", 3)) \
+                || (length == 3 && !strncmp(q, "inf", 3))) {
+                line->values[line->n] = q[0] == 'n' ? NAN : INFINITY;
+                strcpy(line->names[line->n], name);
+                line->n++;
+                name[0] = '\0';
+            } else {
+                memcpy(name, q, length);
+                name[length] = '\0';
+            }
+        } else {
+            p++;
+        }
+    }
+}
+
+
+/* Growable table */
+static int append_row(rr_table * table, size_t * capacity, \
+        const double * values, size_t cols) {
+    if ((table->rows + 1) * cols > *capacity) {
+        size_t new_capacity = *capacity ? 2 * *capacity : 1024 * cols;
+        double * data = realloc(table->data, new_capacity * sizeof(double));
+        if (data == NULL) return -1;
+        table->data = data;
+        *capacity = new_capacity;
+    }
+    memcpy(table->data + table->rows * cols, values, cols * sizeof(double));
+    table->rows++;
+    return 0;
+}
+
+static void set_names(rr_table * table, const line_values * line) {
+    for (int j = 0; j < abs(line->n); j++) {
+        strcpy(table->names[j], line->names[j]);
+    }
+}
+
+/* Reads a file of any of the output kinds into table */
+static int read_table(const char * filename, rr_table * table, int kind) {
+    memset(table, 0, sizeof(rr_table));
+    table->time = NAN;
+
+    mapped_file file;
+    if (map_file(filename, &file) < 0) return -1;
+
+    size_t capacity = 0;
+    int status = 0;
+    int first_line = 1;
+    int half_facet = 0; // For interfaces, if the first point has been read
+    double facet[4];
+    line_values line;
+
+    const char * p = file.start;
+    while (p < file.end && status == 0) {
+        const char * eol = memchr(p, '\n', file.end - p);
+        if (eol == NULL) eol = file.end;
+        parse_line(p, eol, &line);
+
+        if (line.n < 0) {
+            // Header line with the column names
+            set_names(table, &line);
+            table->cols = -line.n;
+        } else if (line.n == 0) {
+            // Blank line, which separates facets in the interface files
+            half_facet = 0;
+        } else if (kind == LOG_FILE) {
+            // Only the lines starting with "t = " are log outputs
+            if (!strcmp(line.names[0], "t") && !strncmp(p, "t = ", 4)) {
+                if (table->cols == 0) {
+                    table->cols = line.n;
+                    set_names(table, &line);
+                }
+                if (line.n == table->cols) {
+                    status = append_row(table, &capacity, line.values, \
+                        table->cols);
+                }
+            }
+        } else if (kind == INTERFACE_FILE) {
+            // Each facet is a pair of "x y" lines
+            if (line.n >= 2) {
+                facet[2 * half_facet] = line.values[0];
+                facet[2 * half_facet + 1] = line.values[1];
+                if (half_facet) {
+                    status = append_row(table, &capacity, facet, 4);
+                }
+                half_facet = !half_facet;
+            }
+        } else {
+            // Plate and field outputs, where the first line of the plate
+            // outputs may be the time the file was written
+            if (first_line && kind == PLATE_FILE && line.n == 1 \
+                    && !strcmp(line.names[0], "t")) {
+                table->time = line.values[0];
+            } else {
+                if (table->cols == 0) {
+                    table->cols = line.n;
+                    if (line.names[0][0] != '\0') set_names(table, &line);
+                }
+                if (line.n == table->cols) {
+                    status = append_row(table, &capacity, line.values, \
+                        table->cols);
+                }
+            }
+        }
+
+        first_line = 0;
+        p = eol + 1;
+    }
+
+    if (kind == INTERFACE_FILE) {
+        table->cols = 4;
+        strcpy(table->names[0], "x1");
+        strcpy(table->names[1], "y1");
+        strcpy(table->names[2], "x2");
+        strcpy(table->names[3], "y2");
+    } else if (kind == PLATE_FILE && table->names[0][0] == '\0' \
+            && table->cols == 4) {
+        // Cleaned plate outputs have no names, but have the same columns
+        strcpy(table->names[0], "y");
+        strcpy(table->names[1], "x");
+        strcpy(table->names[2], "p");
+        strcpy(table->names[3], "strss");
+    }
+
+    unmap_file(&file);
+    return status;
+}
+
+/* Decodes a compressed snapshot (see field_codec.h) into table, with the
+columns x, y, then the fields, then the size of each cell delta */
+static int read_compressed(const char * filename, rr_table * table) {
+    memset(table, 0, sizeof(rr_table));
+    table->time = NAN;
+
+    mapped_file file;
+    if (map_file(filename, &file) < 0) return -1;
+    const unsigned char * end = (const unsigned char *) file.end;
+
+    codec_header header = {0};
+    const unsigned char * p \
+        = codec_read_header((const unsigned char *) file.start, end, &header);
+    int status = p == NULL ? -1 : 0;
+    size_t cols = header.field_no + 3;
+    unsigned char * levels = NULL;
+    if (status == 0) {
+        levels = malloc(header.leaf_no + 1);
+        table->data = malloc((header.leaf_no * cols + 1) * sizeof(double));
+        if (levels == NULL || table->data == NULL) status = -1;
+    }
+
+    /* Positions of the cells from the levels of the leaves */
+    const unsigned char * section, * section_end;
+    if (status == 0 && (codec_section(&p, end, &section, &section_end) < 0 \
+            || codec_decode_levels(section, section_end, levels, \
+                header.leaf_no) < 0)) {
+        status = -1;
+    }
+    if (status == 0 && header.leaf_no > 0 \
+            && codec_place_leaves(levels, header.leaf_no, 0, 0, header.X0, \
+                header.Y0, header.L0, table->data, table->data + 1, \
+                table->data + cols - 1, cols) != header.leaf_no) {
+        status = -1;
+    }
+
+    /* Values of the fields */
+    for (int j = 0; j < header.field_no && status == 0; j++) {
+        if (codec_section(&p, end, &section, &section_end) < 0 \
+                || codec_decode_values(section, section_end, \
+                    header.error_bounds[j], header.leaf_no, \
+                    table->data + 2 + j, cols) < 0) {
+            status = -1;
+        }
+    }
+
+    if (status == 0) {
+        table->rows = header.leaf_no;
+        table->cols = cols;
+        table->time = header.t;
+        strcpy(table->names[0], "x");
+        strcpy(table->names[1], "y");
+        for (int j = 0; j < header.field_no; j++) {
+            strcpy(table->names[2 + j], header.names[j]);
+        }
+        strcpy(table->names[cols - 1], "delta");
+    } else {
+        free(table->data);
+        table->data = NULL;
+    }
+    free(levels);
+    unmap_file(&file);
+    return status;
+}
+
+/* Reads the trajectory stream of the tracers (see tracers.h) into table,
+with one row of t, id, x, y per tracer per frame. A last frame cut short by
+a stopped run is ignored */
+static int read_tracers(const char * filename, rr_table * table) {
+    memset(table, 0, sizeof(rr_table));
+    table->time = NAN;
+
+    mapped_file file;
+    if (map_file(filename, &file) < 0) return -1;
+    const unsigned char * end = (const unsigned char *) file.end;
+    const unsigned char * p \
+        = tracer_read_header((const unsigned char *) file.start, end);
+    if (p == NULL) {
+        unmap_file(&file);
+        return -1;
+    }
+
+    /* Counts the rows first, so the table is allocated once */
+    const unsigned char * frames = p, * records;
+    double t;
+    int n;
+    size_t rows = 0;
+    while (tracer_read_frame(&p, end, &t, &n, &records) == 0) rows += n;
+
+    table->cols = 4;
+    table->data = malloc((rows * table->cols + 1) * sizeof(double));
+    if (table->data == NULL) {
+        unmap_file(&file);
+        return -1;
+    }
+    size_t record_size = sizeof(unsigned int) + 2 * sizeof(float);
+    p = frames;
+    while (tracer_read_frame(&p, end, &t, &n, &records) == 0) {
+        for (int k = 0; k < n; k++) {
+            unsigned int id;
+            float position[2];
+            memcpy(&id, records + k * record_size, sizeof(unsigned int));
+            memcpy(position, records + k * record_size + sizeof(unsigned int), \
+                2 * sizeof(float));
+            double * row = table->data + table->rows * table->cols;
+            row[0] = t;
+            row[1] = id;
+            row[2] = position[0];
+            row[3] = position[1];
+            table->rows++;
+        }
+    }
+    strcpy(table->names[0], "t");
+    strcpy(table->names[1], "id");
+    strcpy(table->names[2], "x");
+    strcpy(table->names[3], "y");
+
+    unmap_file(&file);
+    return 0;
+}
+
+int rr_read_log(const char * filename, rr_table * table) {
+    return read_table(filename, table, LOG_FILE);
+}
+
+int rr_read_plate(const char * filename, rr_table * table) {
+    return read_table(filename, table, PLATE_FILE);
+}
+
+int rr_read_interface(const char * filename, rr_table * table) {
+    return read_table(filename, table, INTERFACE_FILE);
+}
+
+int rr_read_field(const char * filename, rr_table * table) {
+    return read_table(filename, table, FIELD_FILE);
+}
+
+int rr_read_compressed(const char * filename, rr_table * table) {
+    return read_compressed(filename, table);
+}
+
+int rr_read_tracers(const char * filename, rr_table * table) {
+    return read_tracers(filename, table);
+}
+
+void rr_free_table(rr_table * table) {
+    free(table->data);
+    table->data = NULL;
+    table->rows = table->cols = 0;
+}
+
+int rr_column(const rr_table * table, const char * name) {
+    for (int j = 0; j < table->cols; j++) {
+        if (!strcmp(table->names[j], name)) return j;
+    }
+    return -1;
+}
+
+
+/* Locating the files of a run */
+
+// Sub-directories of a run that outputs can be found in. The raw outputs are
+// in raw_data, and output_clean.sh moves the log and interfaces out of it
+static const char * search_dirs[] = {"", "raw_data/", "interfaces/"};
+static const int search_dir_no = 3;
+
+/* Finds the file with the given name in the run directory, returning 0 if it
+exists. Paths longer than RR_PATH_LENGTH are not found rather than truncated,
+as a truncated path could name a different file */
+static int find_file(const char * dir, const char * name, char * path) {
+    for (int k = 0; k < search_dir_no; k++) {
+        if (snprintf(path, RR_PATH_LENGTH, "%s/%s%s", dir, search_dirs[k], \
+                name) >= RR_PATH_LENGTH) {
+            return -1;
+        }
+        if (access(path, R_OK) == 0) return 0;
+    }
+    return -1;
+}
+
+/* Finds the file name_n.txt in the run directory, or for the field outputs
+the compressed snapshot name_n.cmp in its place. Returns the kind of the file,
+or -1 if neither exists */
+static int find_output(const char * dir, const char * name, int n, int kind, \
+        char * path) {
+    char filename[RR_PATH_LENGTH];
+    if (snprintf(filename, RR_PATH_LENGTH, "%s_%d.txt", name, n) \
+            >= RR_PATH_LENGTH) {
+        return -1;
+    }
+    if (find_file(dir, filename, path) == 0) return kind;
+    if (kind == FIELD_FILE) {
+        snprintf(filename, RR_PATH_LENGTH, "%s_%d.cmp", name, n);
+        if (find_file(dir, filename, path) == 0) return COMPRESSED_FILE;
+    }
+    return -1;
+}
+
+/* Counts the files name_0.txt, name_1.txt, ... in the run directory */
+static int count_files(const char * dir, const char * name, int kind) {
+    char path[RR_PATH_LENGTH];
+    int n = 0;
+    while (find_output(dir, name, n, kind, path) >= 0) n++;
+    return n;
+}
+
+/* A single file to be read when loading runs */
+typedef struct {
+    rr_table * table;
+    int kind;
+    char path[RR_PATH_LENGTH];
+} read_task;
+
+static void add_tasks(read_task * tasks, int * task_no, const char * dir, \
+        const char * name, rr_table * tables, int n, int kind) {
+    for (int k = 0; k < n; k++) {
+        read_task * task = &tasks[(*task_no)++];
+        task->table = &tables[k];
+        task->kind = find_output(dir, name, k, kind, task->path);
+    }
+}
+
+int rr_load_runs(const char ** dirs, int n, rr_run * runs) {
+    /* Finds all of the files of the runs, so that they can all be read in
+    parallel, independently of which run they are part of */
+    int total_files = 0;
+    for (int k = 0; k < n; k++) {
+        rr_run * run = &runs[k];
+        memset(run, 0, sizeof(rr_run));
+        snprintf(run->dir, RR_PATH_LENGTH, "%s", dirs[k]);
+        run->plate_no = count_files(dirs[k], "plate_output", PLATE_FILE);
+        run->interface_no = count_files(dirs[k], "interface", INTERFACE_FILE);
+        run->field_no = count_files(dirs[k], "field_output", FIELD_FILE);
+        run->plates = calloc(run->plate_no + 1, sizeof(rr_table));
+        run->interfaces = calloc(run->interface_no + 1, sizeof(rr_table));
+        run->fields = calloc(run->field_no + 1, sizeof(rr_table));
+        total_files \
+            += 1 + run->plate_no + run->interface_no + run->field_no;
+    }
+
+    read_task * tasks = malloc(total_files * sizeof(read_task));
+    int task_no = 0;
+    for (int k = 0; k < n; k++) {
+        rr_run * run = &runs[k];
+        read_task * task = &tasks[task_no++];
+        task->table = &run->log;
+        task->kind = LOG_FILE;
+        if (find_file(dirs[k], "log", task->path) < 0) task->path[0] = '\0';
+        add_tasks(tasks, &task_no, dirs[k], "plate_output", run->plates, \
+            run->plate_no, PLATE_FILE);
+        add_tasks(tasks, &task_no, dirs[k], "interface", run->interfaces, \
+            run->interface_no, INTERFACE_FILE);
+        add_tasks(tasks, &task_no, dirs[k], "field_output", run->fields, \
+            run->field_no, FIELD_FILE);
+    }
+
+    /* Reads all of the files in parallel. Dynamic scheduling is used as the
+    field outputs are much larger than the other files */
+    int failures = 0;
+    #pragma omp parallel for schedule(dynamic) reduction(+:failures)
+    for (int j = 0; j < task_no; j++) {
+        int status = tasks[j].kind == COMPRESSED_FILE \
+            ? read_compressed(tasks[j].path, tasks[j].table) \
+            : read_table(tasks[j].path, tasks[j].table, tasks[j].kind);
+        if (status < 0) failures++;
+    }
+
+    free(tasks);
+    return failures;
+}
+
+int rr_load_run(const char * dir, rr_run * run) {
+    return rr_load_runs(&dir, 1, run);
+}
+
+void rr_free_run(rr_run * run) {
+    rr_free_table(&run->log);
+    for (int k = 0; k < run->plate_no; k++) rr_free_table(&run->plates[k]);
+    for (int k = 0; k < run->interface_no; k++) {
+        rr_free_table(&run->interfaces[k]);
+    }
+    for (int k = 0; k < run->field_no; k++) rr_free_table(&run->fields[k]);
+    free(run->plates);
+    free(run->interfaces);
+    free(run->fields);
+    run->plates = run->interfaces = run->fields = NULL;
+}
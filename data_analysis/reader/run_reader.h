@@ -0,0 +1,69 @@
+/* run_reader.h
+    Library for reading the output of the droplet_impact_plate simulations into
+    typed arrays. Files are memory-mapped and parsed directly from the mapping,
+    and the files of many runs are loaded in parallel using OpenMP, so whole
+    campaigns can be loaded at once. Works on both the raw_data directory of a
+    run and a run directory after output_clean.sh has been called.
+
+    Every output file is read into an rr_table, which stores the numeric values
+    of the file as a row-major array with one row per line of data. The columns
+    are named after the quantities in the file where they are labelled (e.g.
+    "t", "F", "s" for the log file, or "y", "x", "p", "strss" for the plate
+    output files).
+*/
+
+#ifndef RUN_READER_H
+#define RUN_READER_H
+
+#include <stddef.h>
+
+#define RR_MAX_COLUMNS 32 // Maximum number of columns in a table
+#define RR_NAME_LENGTH 32 // Maximum length of a column name
+#define RR_PATH_LENGTH 1024 // Maximum length of a file path
+
+/* Numeric contents of one output file */
+typedef struct {
+    double * data; // Values of the table, stored row by row
+    size_t rows; // Number of rows
+    size_t cols; // Number of columns
+    double time; // Time from a "t = ..." header line (NAN if there is none)
+    char names[RR_MAX_COLUMNS][RR_NAME_LENGTH]; // Names of the columns
+} rr_table;
+
+/* All of the outputs of one run */
+typedef struct {
+    char dir[RR_PATH_LENGTH]; // Directory the run was loaded from
+    rr_table log; // Log file, with one row per log output
+    int plate_no; // Number of plate_output_N.txt files
+    rr_table * plates; // Plate outputs, with rows (y, x, p, strss)
+    int interface_no; // Number of interface_N.txt files
+    rr_table * interfaces; // Interfaces, with rows (x1, y1, x2, y2) per facet
+    int field_no; // Number of field_output_N.txt files
+    rr_table * fields; // Field outputs, with rows (x, y, p, f, u.x, u.y), or
+    // (x, y, p, f, u.x, u.y, delta) per leaf cell for compressed snapshots
+} rr_run;
+
+/* Readers for the individual output files. Each returns 0 on success and
+-1 if the file could not be read. rr_read_compressed decodes the compressed
+snapshots field_output_N.cmp written with COMPRESSED_OUTPUT, and 
+rr_read_tracers the trajectory stream tracers.trj, with rows (t, id, x, y) */
+int rr_read_log(const char * filename, rr_table * table);
+int rr_read_plate(const char * filename, rr_table * table);
+int rr_read_interface(const char * filename, rr_table * table);
+int rr_read_field(const char * filename, rr_table * table);
+int rr_read_compressed(const char * filename, rr_table * table);
+int rr_read_tracers(const char * filename, rr_table * table);
+void rr_free_table(rr_table * table);
+
+/* Returns the index of the column with the given name, or -1 if there is no
+such column */
+int rr_column(const rr_table * table, const char * name);
+
+/* Loads all of the outputs of the n runs in the directories dirs into runs,
+reading the files in parallel. Returns the number of files that could not be
+read */
+int rr_load_runs(const char ** dirs, int n, rr_run * runs);
+int rr_load_run(const char * dir, rr_run * run);
+void rr_free_run(rr_run * run);
+
+#endif
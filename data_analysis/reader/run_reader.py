@@ -0,0 +1,151 @@
+"""run_reader.py
+Python binding for the run output reader library (librun_reader.so, built by
+calling make in this directory). The outputs are exposed as numpy arrays which
+view the memory of the library directly, so no copies are made.
+
+Example:
+    import run_reader
+    runs = run_reader.load_runs(["ALPHA_varying/ALPHA_2", "ALPHA_varying/ALPHA_5.318"])
+    t, F = runs[0].log["t"], runs[0].log["F"]
+    p = runs[0].plates[100][:, 2]
+"""
+
+import ctypes
+import os
+
+import numpy as np
+
+RR_MAX_COLUMNS = 32
+RR_NAME_LENGTH = 32
+RR_PATH_LENGTH = 1024
+
+
+class _Table(ctypes.Structure):
+    _fields_ = [
+        ("data", ctypes.POINTER(ctypes.c_double)),
+        ("rows", ctypes.c_size_t),
+        ("cols", ctypes.c_size_t),
+        ("time", ctypes.c_double),
+        ("names", (ctypes.c_char * RR_NAME_LENGTH) * RR_MAX_COLUMNS),
+    ]
+
+
+class _Run(ctypes.Structure):
+    _fields_ = [
+        ("dir", ctypes.c_char * RR_PATH_LENGTH),
+        ("log", _Table),
+        ("plate_no", ctypes.c_int),
+        ("plates", ctypes.POINTER(_Table)),
+        ("interface_no", ctypes.c_int),
+        ("interfaces", ctypes.POINTER(_Table)),
+        ("field_no", ctypes.c_int),
+        ("fields", ctypes.POINTER(_Table)),
+    ]
+
+
+_lib = ctypes.CDLL(os.path.join(os.path.dirname(os.path.abspath(__file__)),
+                                "librun_reader.so"))
+_lib.rr_load_runs.argtypes = [ctypes.POINTER(ctypes.c_char_p), ctypes.c_int,
+                              ctypes.POINTER(_Run)]
+_lib.rr_load_runs.restype = ctypes.c_int
+_lib.rr_free_run.argtypes = [ctypes.POINTER(_Run)]
+_lib.rr_read_tracers.argtypes = [ctypes.c_char_p, ctypes.POINTER(_Table)]
+_lib.rr_read_tracers.restype = ctypes.c_int
+_lib.rr_free_table.argtypes = [ctypes.POINTER(_Table)]
+
+
+class _Owner:
+    """Frees the runs loaded by the library once no arrays refer to them"""
+
+    def __init__(self, runs):
+        self.runs = runs
+
+    def __del__(self):
+        for k in range(len(self.runs)):
+            _lib.rr_free_run(ctypes.byref(self.runs[k]))
+
+
+class _TableOwner:
+    """Frees a table read on its own once no arrays refer to it"""
+
+    def __init__(self, table):
+        self.table = table
+
+    def __del__(self):
+        _lib.rr_free_table(ctypes.byref(self.table))
+
+
+class _Buffer:
+    """Memory of one table in the library. Arrays viewing the memory keep this
+    object (and so the owner of the memory) alive"""
+
+    def __init__(self, table, owner):
+        self.owner = owner
+        self.__array_interface__ = {
+            "shape": (table.rows, table.cols),
+            "typestr": "<f8",
+            "data": (ctypes.addressof(table.data.contents), True),
+            "version": 3,
+        }
+
+
+class Table(np.ndarray):
+    """Array of the values of one output file. Columns can be accessed by name,
+    e.g. table["p"], and the time of the output (if known) is table.time"""
+
+    def __getitem__(self, key):
+        if isinstance(key, str):
+            return np.asarray(self)[:, self.names.index(key)]
+        return np.ndarray.__getitem__(np.asarray(self), key)
+
+
+def _as_array(table, owner):
+    if table.rows == 0 or not table.data:
+        array = np.zeros((0, table.cols))
+    else:
+        array = np.asarray(_Buffer(table, owner))
+    array = array.view(Table)
+    array.names = [table.names[j].value.decode()
+                   for j in range(table.cols)]
+    array.time = table.time
+    return array
+
+
+class Run:
+    """All of the outputs of one run"""
+
+    def __init__(self, run, owner):
+        self.dir = run.dir.decode()
+        self.log = _as_array(run.log, owner)
+        self.plates = [_as_array(run.plates[k], owner)
+                       for k in range(run.plate_no)]
+        self.plate_times = np.array([plate.time for plate in self.plates])
+        self.interfaces = [_as_array(run.interfaces[k], owner)
+                           for k in range(run.interface_no)]
+        self.fields = [_as_array(run.fields[k], owner)
+                       for k in range(run.field_no)]
+
+
+def load_runs(dirs):
+    """Loads the outputs of all of the run directories in dirs in parallel"""
+    runs = (_Run * len(dirs))()
+    paths = (ctypes.c_char_p * len(dirs))(*[d.encode() for d in dirs])
+    failures = _lib.rr_load_runs(paths, len(dirs), runs)
+    if failures > 0:
+        print(f"run_reader: {failures} files could not be read")
+    owner = _Owner(runs)
+    return [Run(runs[k], owner) for k in range(len(dirs))]
+
+
+def load_run(directory):
+    """Loads the outputs of a single run directory"""
+    return load_runs([directory])[0]
+
+
+def read_tracers(filename):
+    """Reads the trajectory stream tracers.trj of a run, with one row of
+    t, id, x, y per tracer per frame"""
+    table = _Table()
+    if _lib.rr_read_tracers(filename.encode(), ctypes.byref(table)) < 0:
+        raise IOError(f"run_reader: could not read {filename}")
+    return _as_array(table, _TableOwner(table))
@@ -0,0 +1,91 @@
+/* run_reader_mex.c
+    MATLAB binding for the run output reader library. Build in MATLAB with
+    "make run_reader_mex" in this directory (requires mex on the path), then
+    call
+
+    runs = run_reader_mex({dir1, dir2, ...});
+
+    which loads the runs in parallel and returns a struct array with the fields
+    dir, log, log_names, plates, plate_times, interfaces and fields. The plate,
+    interface and field outputs are cell arrays with one matrix per output
+    file, with the same columns as the files (see run_reader.h).
+*/
+
+#include "mex.h"
+#include "run_reader.h"
+#include <string.h>
+
+/* Copies a table into a MATLAB matrix, transposing from row-major order */
+static mxArray * table_matrix(const rr_table * table) {
+    mxArray * matrix = mxCreateDoubleMatrix(table->rows, table->cols, mxREAL);
+    double * values = mxGetPr(matrix);
+    for (size_t i = 0; i < table->rows; i++) {
+        for (size_t j = 0; j < table->cols; j++) {
+            values[j * table->rows + i] = table->data[i * table->cols + j];
+        }
+    }
+    return matrix;
+}
+
+static mxArray * table_cell(const rr_table * tables, int n) {
+    mxArray * cell = mxCreateCellMatrix(n, 1);
+    for (int k = 0; k < n; k++) {
+        mxSetCell(cell, k, table_matrix(&tables[k]));
+    }
+    return cell;
+}
+
+void mexFunction(int nlhs, mxArray * plhs[], int nrhs, const mxArray * prhs[]) {
+    if (nrhs != 1 || !mxIsCell(prhs[0])) {
+        mexErrMsgTxt("Usage: runs = run_reader_mex({dir1, dir2, ...})");
+    }
+
+    /* Reads the directory names */
+    int n = mxGetNumberOfElements(prhs[0]);
+    char ** dirs = mxCalloc(n, sizeof(char *));
+    for (int k = 0; k < n; k++) {
+        dirs[k] = mxArrayToString(mxGetCell(prhs[0], k));
+        if (dirs[k] == NULL) mexErrMsgTxt("Directories must be strings");
+    }
+
+    /* Loads all of the runs in parallel */
+    rr_run * runs = mxCalloc(n, sizeof(rr_run));
+    int failures = rr_load_runs((const char **) dirs, n, runs);
+    if (failures > 0) {
+        mexWarnMsgTxt("Some output files could not be read");
+    }
+
+    /* Converts to a struct array */
+    const char * field_names[] = {"dir", "log", "log_names", "plates", \
+        "plate_times", "interfaces", "fields"};
+    plhs[0] = mxCreateStructMatrix(n, 1, 7, field_names);
+    for (int k = 0; k < n; k++) {
+        rr_run * run = &runs[k];
+        mxSetField(plhs[0], k, "dir", mxCreateString(run->dir));
+        mxSetField(plhs[0], k, "log", table_matrix(&run->log));
+
+        mxArray * log_names = mxCreateCellMatrix(1, run->log.cols);
+        for (int j = 0; j < run->log.cols; j++) {
+            mxSetCell(log_names, j, mxCreateString(run->log.names[j]));
+        }
+        mxSetField(plhs[0], k, "log_names", log_names);
+
+        mxSetField(plhs[0], k, "plates", \
+            table_cell(run->plates, run->plate_no));
+        mxArray * plate_times = mxCreateDoubleMatrix(run->plate_no, 1, mxREAL);
+        for (int j = 0; j < run->plate_no; j++) {
+            mxGetPr(plate_times)[j] = run->plates[j].time;
+        }
+        mxSetField(plhs[0], k, "plate_times", plate_times);
+
+        mxSetField(plhs[0], k, "interfaces", \
+            table_cell(run->interfaces, run->interface_no));
+        mxSetField(plhs[0], k, "fields", \
+            table_cell(run->fields, run->field_no));
+
+        rr_free_run(run);
+        mxFree(dirs[k]);
+    }
+    mxFree(runs);
+    mxFree(dirs);
+}
@@ -0,0 +1,29 @@
+/* wagner_lib.c
+    Builds the Wagner theory models in wagner.h as a shared library 
+    (libwagner.so) for use from other languages, e.g. with Python ctypes. 
+    Array versions of the forces are added so whole time series can be
+    evaluated in one call.
+*/
+
+#include "wagner.h"
+#include <stddef.h>
+
+/* Composite force at the n times ts, with the plate motion ss, sdots and 
+sddots, written into forces */
+void wagner_composite_force_array(const double * ts, const double * ss, \
+        const double * sdots, const double * sddots, double eps, size_t n, \
+        double * forces) {
+    #pragma omp parallel for
+    for (size_t k = 0; k < n; k++) {
+        forces[k] = wagner_composite_force(ts[k], ss[k], sdots[k], sddots[k], \
+            eps);
+    }
+}
+
+/* Composite pressure at the n radial positions rs at the time t */
+void wagner_composite_pressure_array(const double * rs, double t, double s, \
+        double sdot, double sddot, double eps, size_t n, double * pressures) {
+    for (size_t k = 0; k < n; k++) {
+        pressures[k] = wagner_composite_pressure(rs[k], t, s, sdot, sddot, eps);
+    }
+}
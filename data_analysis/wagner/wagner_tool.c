@@ -0,0 +1,139 @@
+/* wagner_tool.c
+    Batch tool for comparing simulations with the Wagner theory models in 
+    wagner.h, replacing the MATLAB scripts in deprecated_data_analysis.
+
+    Usage:
+    ./wagner_tool solution ALPHA BETA GAMMA T_MAX [DT]
+        Prints the plate displacement coupled to the composite force (as 
+        s_solution.m), with the columns t, s, sdot, sddot, outer, inner, 
+        overlap and composite force, from the impact time up to T_MAX
+    ./wagner_tool compare [-i IMPACT_TIME] RUN_DIR ...
+        For each run directory (either raw_data or a cleaned run directory), 
+        writes wagner_comparison.txt into the directory with the columns t, F,
+        composite force for the plate motion of the run and their ratio, and
+        prints the mean ratio over the run. The runs are processed in parallel
+        with OpenMP. IMPACT_TIME defaults to 0.125, the value for the default
+        INITIAL_DROP_HEIGHT.
+*/
+
+#include "run_reader.h"
+#include "wagner.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Index of a log column, looked up by name in a raw log and by position in
+a cleaned log (which has no names) */
+static int log_column(const rr_table * log, const char * name, int position) {
+    int column = rr_column(log, name);
+    return column >= 0 ? column : position;
+}
+
+static int solution(int argc, char * argv[]) {
+    if (argc < 6) {
+        fprintf(stderr, "Usage: %s solution ALPHA BETA GAMMA T_MAX [DT]\n", \
+            argv[0]);
+        return 1;
+    }
+    double alpha = atof(argv[2]), beta = atof(argv[3]), gamma = atof(argv[4]);
+    double t_max = atof(argv[5]);
+    double dt = argc > 6 ? atof(argv[6]) : 1e-4;
+    int n = (int) (t_max / dt) + 1;
+    double * ts = malloc(4 * n * sizeof(double));
+    double * ss = ts + n, * sdots = ts + 2 * n, * sddots = ts + 3 * n;
+    wagner_plate_solution(alpha, beta, gamma, 1., dt, n, ts, ss, sdots, sddots);
+
+    printf("# t, s, sdot, sddot, outer, inner, overlap, composite\n");
+    for (int k = 0; k < n; k++) {
+        double t = ts[k], s = ss[k], sdot = sdots[k], sddot = sddots[k];
+        printf("%g, %g, %g, %g, %g, %g, %g, %g\n", t, s, sdot, sddot, \
+            wagner_outer_force(t, s, sdot, sddot, 1.), \
+            wagner_inner_force(t, s, sdot, sddot, 1.), \
+            wagner_overlap_force(t, s, sdot, sddot, 1.), \
+            wagner_composite_force(t, s, sdot, sddot, 1.));
+    }
+    free(ts);
+    return 0;
+}
+
+static int compare(int argc, char * argv[]) {
+    double impact_time = 0.125;
+    int first = 2;
+    if (argc > 3 && !strcmp(argv[2], "-i")) {
+        impact_time = atof(argv[3]);
+        first = 4;
+    }
+    int n = argc - first;
+    if (n <= 0) {
+        fprintf(stderr, "Usage: %s compare [-i IMPACT_TIME] RUN_DIR ...\n", \
+            argv[0]);
+        return 1;
+    }
+
+    const char ** dirs = (const char **) &argv[first];
+    double * mean_ratios = calloc(n, sizeof(double));
+    int failures = 0;
+
+    #pragma omp parallel for schedule(dynamic) reduction(+:failures)
+    for (int k = 0; k < n; k++) {
+        char filename[RR_PATH_LENGTH + 32];
+        rr_table log;
+        snprintf(filename, sizeof(filename), "%s/log", dirs[k]);
+        if (rr_read_log(filename, &log) < 0 || log.rows == 0) {
+            snprintf(filename, sizeof(filename), "%s/output.txt", dirs[k]);
+            if (rr_read_field(filename, &log) < 0) {
+                failures++;
+                continue;
+            }
+        }
+        int ct = log_column(&log, "t", 0), cF = log_column(&log, "F", 1);
+        int cs = log_column(&log, "s", 5);
+        int csdot = log_column(&log, "ds_dt", 6);
+        int csddot = log_column(&log, "d2s_dt2", 7);
+
+        snprintf(filename, sizeof(filename), "%s/wagner_comparison.txt", \
+            dirs[k]);
+        FILE * fp = fopen(filename, "w");
+        if (fp == NULL) {
+            rr_free_table(&log);
+            failures++;
+            continue;
+        }
+        fprintf(fp, "# t, F, composite, ratio\n");
+        double ratio_sum = 0.;
+        int ratio_no = 0;
+        for (size_t j = 0; j < log.rows; j++) {
+            const double * row = &log.data[j * log.cols];
+            double t = row[ct] - impact_time;
+            double composite = wagner_composite_force(t, row[cs], \
+                row[csdot], row[csddot], 1.);
+            double ratio = composite > 0. ? row[cF] / composite : 0.;
+            fprintf(fp, "%g, %g, %g, %g\n", row[ct], row[cF], composite, \
+                ratio);
+            if (composite > 0.) {
+                ratio_sum += ratio;
+                ratio_no++;
+            }
+        }
+        fclose(fp);
+        mean_ratios[k] = ratio_no > 0 ? ratio_sum / ratio_no : 0.;
+        rr_free_table(&log);
+    }
+
+    for (int k = 0; k < n; k++) {
+        printf("%s, mean ratio F / composite = %g\n", dirs[k], mean_ratios[k]);
+    }
+    free(mean_ratios);
+    if (failures > 0) {
+        fprintf(stderr, "%d runs could not be read\n", failures);
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char * argv[]) {
+    if (argc > 1 && !strcmp(argv[1], "solution")) return solution(argc, argv);
+    if (argc > 1 && !strcmp(argv[1], "compare")) return compare(argc, argv);
+    fprintf(stderr, "Usage: %s solution|compare ...\n", argv[0]);
+    return 1;
+}
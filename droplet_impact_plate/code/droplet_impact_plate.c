@@ -16,11 +16,27 @@
 #endif
 #include "navier-stokes/centered.h" // To solve the Navier-Stokes
 #include "two-phase.h" // Implements two-phase flow
+#if MOVIES
 #include "view.h" // Creating movies using bview
+#endif
 #include "tension.h" // Surface tension of droplet
 #include "tag.h" // For removing small droplets
 #include "contact.h" // For imposing contact angle on the surface
+#include "wagner.h" // Wagner theory reference models
+#include "field_codec.h" // Error-bounded compression of the field outputs
+#include "run_archive.h" // Single-file container of the outputs
+#include "plugin_api.h" // Interface of the analysis plugins
+#include "tracers.h" // Lagrangian tracer particles
 #include <omp.h> // For openMP parallel
+#include <sys/resource.h> // For measuring the peak memory usage
+#include <sys/socket.h> // For serving the live metrics over HTTP
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <unistd.h>
+#include <dlfcn.h> // For loading the analysis plugins
+#include <stdarg.h>
 
 /* Physical constants */
 double REYNOLDS; // Reynolds number of liquid
@@ -42,9 +58,14 @@ double end_wall_time; // Time the simulation finished
 int gfs_output_no = 0; // Records how many GFS files have been outputted
 int plate_output_no = 0; // Records how many plate data files there have been
 int interface_output_no = 0; // Records how many interface files there have been
+int snapshot_no = 0; // Records how many movie snapshots there have been
+int roi_output_no = 0; // Records how many region of interest files there have been
 double pinch_off_time = 0.; // Time pinch-off of the entrapped bubble occurs
 double drop_thresh = 1e-4; // Remove droplets threshold
 double bubble_area = 0.; // Area of entrapped bubble
+double bubble_area_time = -HUGE; // Time the bubble area was last updated
+double bubble_centroid_x = 0.; // Centroid of the entrapped bubble
+double bubble_centroid_y = 0.;
 char interface_time_filename[80] \
     = "interface_times.txt"; // Stores the time the interface was outputted
 
@@ -57,6 +78,8 @@ double stdFilter; // Standard deviation of force over last PEAK_LAG timesteps
 int peak_no = 0; // Number of times we have done peak detection
 double previous_avg = 0; // Value of avgFilter in previous timestep
 double previous_std = 0; // Value of stdFilter in previous timestep
+double wagner_force_current = 0.; // Wagner force at the current plate step
+double wagner_force_previous = 0.; // Wagner force at the previous plate step
 
 /* Plate position variables */
 double s_previous = 0.; // Value of s at previous timestep
@@ -64,27 +87,104 @@ double s_current = 0.; // Value of s at current timestep
 double s_next; // Values of s at next timestep
 double ds_dt; // First time derivative of s
 double d2s_dt2; // Second time derivative of s
+double plate_dt_previous = 0.; // Step size of the previous plate update
+double added_mass_correction = 0.; // Force correction of the last added mass solve
+
+/* Diagnostic sampling variables */
+double next_removal_time = 0.; // Time of the next droplet removal
+double next_log_time = 0.; // Time of the next log output
+double next_wagner_time = 0.; // Time of the next output to wagner.dat
+double log_t_previous = -1.; // Time of the previous solver step
+double log_previous[8]; // Log quantities at the previous solver step
+
+/* Adaptive output cadence */
+typedef struct {
+    double interval; // Fixed output interval the cadence is relative to
+    double next_time; // Time of the next output
+    double last_time; // Time of the last output
+    int count; // Number of outputs so far
+} output_schedule;
+output_schedule plate_schedule, interface_schedule, gfs_schedule, \
+    roi_schedule;
+double force_peak_time = -HUGE; // Time of the last peak found in the force
+
+/* Poisson solver tolerance schedule */
+double fine_tolerance; // Tolerance used near impact and pinch-off
+int fine_nitermax; // Maximum number of iterations near impact and pinch-off
+double drop_gap = HUGE; // Gap between the bottom of the droplet and the plate
+scalar p_previous; // Pressure at the previous step, for extrapolation
+double pressure_dt_previous = 0.; // Timestep of the previous step
 
 /* Stats output */
 FILE * fp_stats; 
+FILE * fp_memory; // Memory usage of the fields
+FILE * fp_solver; // Multigrid solver stats
+FILE * fp_wagner; // Ratio of the force to Wagner theory
+double step_wall_time = 0.; // Wall time at the end of the previous step
+run_archive archive; // Container of the outputs with ARCHIVE_OUTPUT
+
+/* Analysis plugins */
+#define MAX_PLUGINS 16
+enum { PLUGIN_INIT, PLUGIN_STEP, PLUGIN_PLATE_FORCE, PLUGIN_END }; // Hooks
+const plugin_definition * plugins[MAX_PLUGINS]; // Loaded plugins
+char plugin_args[MAX_PLUGINS][256]; // Argument strings of the plugins
+bool plugin_enabled[MAX_PLUGINS]; // False if the init hook of a plugin failed
+int plugin_no = 0; // Number of loaded plugins
+FILE * fp_plugins = NULL; // Shared output of the plugins
+
+/* Tracer particles */
+tracer_set tracers = {NULL, 0, 0, 0}; // Tracers, sorted by their cell
+double next_tracer_time = 0.; // Time of the next trajectory frame
+bool jet_tracers_seeded = false; // True once the jet has been seeded
+FILE * fp_tracers = NULL; // Trajectory stream
+
+/* Live metrics */
+double metrics_wall_time = -1.; // Wall time of the last metrics file update
+double metrics_t = 0.; // Simulation time of the last metrics file update
+int metrics_i = 0; // Step of the last metrics file update
+double metrics_step_rate = 0.; // Steps per wall second since the last update
+double metrics_eta = -1.; // Estimated wall time to finish (s)
+int metrics_socket = -1; // Listening socket for the HTTP endpoint
+#define METRICS_MAX_CLIENTS 8
+int metrics_clients[METRICS_MAX_CLIENTS]; // Connections waiting for a request
+double metrics_client_times[METRICS_MAX_CLIENTS]; // Wall time they were opened
+int metrics_client_no = 0; // Number of waiting connections
 char interp_stats_filename[80] = "interp_stats.txt";
 
 /* Contact angle variables */ 
-vector h[]; // Height function
+vector h[]; // Height function, computed once per step by contact.h (with the
+// contact angle applied) and reused by tension.h for the curvature
 double theta0 = 90; // Contact angle in degrees
 
-/* Bubble counting */
-scalar bubbles[]; // Tag field for bubbles
-
 /* Boundary conditions */
+// Robin condition a p + b dp/dn = c, written as a combination of the Dirichlet
+// and Neumann conditions so it works with the multigrid solver
+#define robin(a, b, c) ((dirichlet((c) * Delta / (2. * (b) + (a) * Delta))) \
+    + ((neumann(0.)) * ((2. * (b) - (a) * Delta) / (2. * (b) + (a) * Delta) \
+    + 1.)))
+
+// Far-field decay of the pressure, p ~ r^(-FAR_FIELD_POWER) with the distance
+// r from the point of impact. This is the condition dp/dn = - m p n_r / r,
+// where n_r is the component of the boundary normal along r. The pressure is 
+// then no longer forced to zero at the boundary, so it feels the box less
+#if AXISYMMETRIC
+#define FAR_FIELD_POWER 2. // Dipole decay of the axisymmetric potential
+#else
+#define FAR_FIELD_POWER 1. // Dipole decay of the planar potential
+#endif
+#define far_field(normal) \
+    (robin(FAR_FIELD_POWER * (normal) / (sq(x) + sq(y)), 1., 0.))
+
 // Conditions for entry from above
 u.n[right] = neumann(0.); // Free flow condition
-p[right] = dirichlet(0.); // 0 pressure far from surface
+p[right] = FAR_FIELD_BC ? far_field(x) \
+    : dirichlet(0.); // 0 pressure far from surface
 
 // Conditions far from the droplet in the radial direction
 u.n[top] = neumann(0.); // Allows outflow through boundary
 u.t[top] = dirichlet(0.); // Stationary vertical flow
-p[top] = dirichlet(0.); // 0 pressure far from surface
+p[top] = FAR_FIELD_BC ? far_field(y) \
+    : dirichlet(0.); // 0 pressure far from surface
 
 // Conditions on surface
 u.n[left] = dirichlet(0.); // No flow through surface
@@ -99,10 +199,67 @@ u.n[bottom] = dirichlet(0.);
 // Function for doing peak detection
 void peak_detect(double current_force);
 
-// Function for removing droplets away from a specific region
-void remove_droplets_region(struct RemoveDroplets p,\
+// Functions for the Wagner theory force for the current plate motion, and the
+// prediction used to replace peaks in the force
+double wagner_force();
+double wagner_prediction(double previous_force);
+
+// Functions for the force on the plate and solving the plate ODE
+double plate_force(scalar pressure, bool viscous);
+double plate_position(double force, double h_next, double h_previous);
+double plate_velocity(double s_new, double h_next, double h_previous);
+double plate_acceleration(double s_new, double h_next, double h_previous);
+
+// Function for the strongly coupled plate force
+double coupled_force(double force, double h_next, double h_previous);
+
+// Function for checking if a diagnostic is due when running every solver step
+bool sample_due(double * next_time, double interval);
+
+// Function for checking if an output is due, with the adaptive cadence
+bool output_due(output_schedule * schedule);
+
+// Function for finding the centre of the region of interest window
+bool roi_centre(double * xc, double * yc);
+
+// Function for removing droplets away from a specific region, using the field
+// d to tag the droplets
+void remove_droplets_region(struct RemoveDroplets p, scalar d, \
         double ignore_region_x_limit, double ignore_region_y_limit);
 
+// Function for writing the memory used by the fields
+void memory_report(FILE * fp);
+
+// Functions for the initial condition and the adaptive refinement, which are 
+// shared by the events and the preflight mode
+void initial_condition();
+void adapt_grid();
+
+// Function for reporting the initial grid and exiting in preflight mode
+void preflight();
+
+// Function for writing a compressed snapshot of the fields
+void output_compressed(char * filename);
+
+// Functions for opening and closing the output files, which are written into
+// the run archive instead with ARCHIVE_OUTPUT
+FILE * output_open(const char * name, const char * mode);
+void output_close(FILE * fp);
+
+// Functions for seeding the tracers and interpolating the velocity to them
+void tracers_seed(double xmin, double xmax, double ymin, double ymax, \
+    bool liquid);
+double tracer_velocity(Point point, scalar s, double xp, double yp);
+
+// Functions for loading the analysis plugins and calling their hooks
+int plugins_load(const char * filename);
+void plugins_call(int hook);
+
+// Functions for writing the live metrics and serving them over HTTP
+void metrics_write(FILE * fp);
+void metrics_listen(int port);
+void metrics_serve();
+
 
 int main() {
 /* Main function to set up the simulation */
@@ -124,6 +281,7 @@ int main() {
     mu1 = 1. / REYNOLDS; // Viscosity of water phase
     mu2 = mu1 * MU_R; // Viscosity of air phase
     f.sigma = 1. / WEBER; // Surface tension at interface
+    f.height = h; // Height functions shared by contact.h and the curvature
 
     /* Derived constants */
     MIN_CELL_SIZE = BOX_WIDTH / pow(2, MAXLEVEL); // Size of the smallest cell
@@ -148,30 +306,115 @@ int main() {
         filtered_forces = malloc(PEAK_LAG * sizeof(double));
     }
 
+    /* Output schedules, relative to the fixed output intervals */
+    plate_schedule.interval = PLATE_OUTPUT_TIMESTEP;
+    interface_schedule.interval = INTERFACE_OUTPUT_TIMESTEP;
+    gfs_schedule.interval = GFS_OUTPUT_TIMESTEP;
+    roi_schedule.interval = ROI_OUTPUT_TIMESTEP;
+    plate_schedule.last_time = interface_schedule.last_time \
+        = gfs_schedule.last_time = roi_schedule.last_time = -HUGE;
+
+    /* In preflight mode only the initial grid is built and reported, without
+    creating any of the outputs of a run */
+    if (PREFLIGHT) {
+        preflight();
+        return 0;
+    }
+
+    /* Single container for all of the outputs apart from the log, movies
+    and live metrics, extracted with data_analysis/archive */
+    if (ARCHIVE_OUTPUT) {
+        if (archive_open(&archive, "run.rca", 1) < 0) {
+            fprintf(stderr, "Error: could not open the run archive\n");
+            return 1;
+        }
+    }
+
+    /* Analysis plugins, which are loaded before the run starts so that a 
+    missing plugin stops the run straight away */
+    if (plugins_load(PLUGIN_FILE) < 0) {
+        return 1;
+    }
+
     /* Initialises interface time file */
-    FILE* interface_time_file = fopen(interface_time_filename, "w");
-    fclose(interface_time_file);
+    FILE* interface_time_file = output_open(interface_time_filename, "w");
+    output_close(interface_time_file);
 
     /* Initialises interp stats file */
-    FILE * interp_stats_file = fopen(interp_stats_filename, "w");
-    fclose(interp_stats_file);
+    FILE * interp_stats_file = output_open(interp_stats_filename, "w");
+    output_close(interp_stats_file);
 
     /* Open stats file */
     char name[200];
     sprintf(name, "logstats.dat");
-    fp_stats = fopen(name, "w");
+    fp_stats = output_open(name, "w");
+    if (MEMORY_STATS) {
+        fp_memory = output_open("memory_stats.dat", "w");
+    }
+    if (SOLVER_STATS) {
+        fp_solver = output_open("solver_stats.dat", "w");
+    }
+    #if AXISYMMETRIC
+    if (WAGNER_OUTPUT) {
+        fp_wagner = output_open("wagner.dat", "w");
+    }
+    #endif
+
+    /* Trajectory stream of the tracers */
+    if (TRACER_NO > 0) {
+        fp_tracers = output_open("tracers.trj", "w");
+        tracer_write_header(fp_tracers);
+    }
+
+    /* Live metrics endpoint */
+    if (METRICS_PORT > 0) {
+        metrics_listen(METRICS_PORT);
+    }
 
     /* Poisson solver constants */
+    #if DIAGNOSTIC_SAMPLING
+    DT = SAMPLING_MAX_DT; // Maximum timestep
+    #else
     DT = 1.0e-4; // Minimum timestep
+    #endif
     NITERMIN = 1; // Min number of iterations (default 1)
     NITERMAX = 300; // Max number of iterations (default 100)
     TOLERANCE = 1e-5; // Possion solver tolerance (default 1e-3)
+    fine_tolerance = TOLERANCE;
+    fine_nitermax = NITERMAX;
 
     // Run the simulation
     run();
 
-    // Close stats file
-    fclose(fp_stats);
+    // Close stats files
+    output_close(fp_stats);
+    if (MEMORY_STATS) {
+        output_close(fp_memory);
+    }
+    if (SOLVER_STATS) {
+        output_close(fp_solver);
+    }
+    #if AXISYMMETRIC
+    if (WAGNER_OUTPUT) {
+        output_close(fp_wagner);
+    }
+    #endif
+    if (fp_plugins != NULL) {
+        output_close(fp_plugins);
+    }
+    if (fp_tracers != NULL) {
+        output_close(fp_tracers);
+        free(tracers.p);
+    }
+    if (ARCHIVE_OUTPUT) {
+        archive_close(&archive, t);
+    }
+    if (metrics_socket >= 0) {
+        close(metrics_socket);
+        for (int k = 0; k < metrics_client_no; k++) {
+            close(metrics_clients[k]);
+        }
+    }
 }
 
 
@@ -181,72 +424,68 @@ event init(t = 0) {
     // Records the wall time
     start_wall_time = omp_get_wtime();
 
-    /* Refines around the droplet */
-    refine(sq(x - DROP_CENTRE) + sq(y) < sq(DROP_RADIUS + DROP_REFINED_WIDTH) \
-        && sq(x - DROP_CENTRE) + sq(y) > sq(DROP_RADIUS - DROP_REFINED_WIDTH) \
-        && level < MAXLEVEL);
-    
-    /* Initialises the droplet volume fraction */
-    fraction(f, -sq(x - DROP_CENTRE) - sq(y) + sq(DROP_RADIUS));
+    // The previous pressure is only stored if it is used for extrapolation
+    if (PRESSURE_EXTRAPOLATION) {
+        p_previous = new scalar;
+    }
 
-    /* Initialise the droplet velocity downwards */
-    foreach() {
-        u.x[] = DROP_VEL * f[];
+    initial_condition();
+
+    // Tracers in the air film between the droplet and the plate
+    if (TRACER_NO > 0) {
+        tracers_seed(X0, X0 + INITIAL_DROP_HEIGHT, Y0, \
+            Y0 + TRACER_FILM_WIDTH, false);
     }
-    boundary ((scalar *){u});
+
+    plugins_call(PLUGIN_INIT);
 }
 
 
 event refinement (i++) {
 /* Refines the grid where appropriate */
-
-    /* Adapts with respect to velocities and volume fraction */
-    adapt_wavelet ({u.x, u.y, f}, (double[]){1e-3, 1e-3, 1e-6}, 
-        minlevel = MINLEVEL, maxlevel = MAXLEVEL);
-    
-    /* Refines above the plate */
-    refine((y < PLATE_WIDTH) && (x <= PLATE_REFINED_WIDTH) \
-        && level < MAXLEVEL);
+    adapt_grid();
 }
 
 
+#if DIAGNOSTIC_SAMPLING
+event moving_plate (i++) {
+#else
 event moving_plate (t += 1e-4) {
+#endif
 /* Moves the plate as a function of the force on it */
 
     /* Calculate the force on the plate by integrating using trapezoidal rule */
-    current_force = 0.; // Initialise to be zero
-
-    // Iterates over the solid boundary
-    foreach_boundary(left, reduction(+:current_force)) {
-        if (y < PLATE_WIDTH) {
-            // Viscosity average in the cell above the plate
-            double avg_mu = f[] * (mu1 - mu2) + mu2;
-
-            // Viscous stress in the cell above the plate
-            double viscous_stress = \
-                - 2 * avg_mu * (u.x[1, 0] - u.x[]) / Delta;
+    current_force = plate_force(p, true);
+    wagner_force_current = wagner_force();
 
-            // Adds the contribution to the force using trapeze rule, depending 
-            // on if we are in the axisymmetric setting or not
-            #if AXISYMMETRIC
-            current_force += y * Delta * (p[] + viscous_stress);
-            #else
-            current_force += Delta * (p[] + viscous_stress);
-            #endif
-        }
+    /* Compares the force to Wagner theory for the current plate motion, at
+    most once every LOG_OUTPUT_TIMESTEP */
+    #if AXISYMMETRIC
+    if (WAGNER_OUTPUT && (wagner_force_current > 0.) \
+            && (t >= START_OUTPUT_TIME) && (t <= END_OUTPUT_TIME) \
+            && sample_due(&next_wagner_time, LOG_OUTPUT_TIMESTEP)) {
+        fprintf(fp_wagner, "t = %g, F = %.6f, wagner_F = %.6f, ratio = %g\n", \
+            t, current_force, wagner_force_current, \
+            current_force / wagner_force_current);
     }
+    #endif
 
-    // Integrates about angular part in axisymmetric, or doubles in 2D to take 
-    // into account the other side of the plate
-
-    #if AXISYMMETRIC
-    current_force = 2 * pi * current_force; 
+    /* Step sizes of the ODE. With diagnostic sampling the plate is moved 
+    every solver step, so the step sizes can differ */
+    #if DIAGNOSTIC_SAMPLING
+    double h_next = dt; // Step size to the next plate position
+    double h_previous \
+        = plate_dt_previous > 0. ? plate_dt_previous : dt; // Previous step
+    plate_dt_previous = dt;
     #else
-    current_force = 2 * current_force; 
+    double h_next = DT, h_previous = DT;
     #endif
-    
-    // If the peak detect parameter is satisfied
-    if (PEAK_DETECT) {
+
+    if (IMPLICIT_ADDED_MASS && !CONST_ACC && !IMPOSED) {
+        // The added mass correction replaces the peak detection
+        force_term = coupled_force(current_force, h_next, h_previous);
+    } else if (PEAK_DETECT) {
+        // If the peak detect parameter is satisfied
         peak_detect(current_force);
     } else {
         // Without peak detect, we set the force term to the current force
@@ -256,16 +495,15 @@ event moving_plate (t += 1e-4) {
     // If before force delay time, we set the force term to be zero
     if (t < FORCE_DELAY_TIME) force_term = 0;
 
+    plugins_call(PLUGIN_PLATE_FORCE);
+
     /* Solves the ODE for the updated plate position and acceleration using 
     a second-order explicit finite difference scheme */
-    s_next = (DT * DT * force_term \
-        + (2. * ALPHA - DT * DT * GAMMA) * s_current \
-        - (ALPHA - DT * BETA / 2.) * s_previous) \
-        / (ALPHA + DT * BETA / 2.);
+    s_next = plate_position(force_term, h_next, h_previous);
 
     /* Updates values of s and its derivatives */
-    ds_dt = (s_next - s_previous) / (2. * DT);
-    d2s_dt2 = (s_next - 2 * s_current + s_previous) / (DT * DT);
+    ds_dt = plate_velocity(s_next, h_next, h_previous);
+    d2s_dt2 = plate_acceleration(s_next, h_next, h_previous);
     s_previous = s_current;
     s_current = s_next; 
 
@@ -302,6 +540,8 @@ event moving_plate (t += 1e-4) {
     u.t[top] = dirichlet(ds_dt);
     u.n[left] = y < PLATE_WIDTH ? dirichlet(0.) : dirichlet(ds_dt);
 
+    wagner_force_previous = wagner_force_current;
+
     boundary ((scalar *){u}); // Redefine boundary conditions for u
 }
 
@@ -314,14 +554,74 @@ event acceleration (i++) {
     foreach_face(x){
         av.x[] += d2s_dt2 - 1./sq(FROUDE);
     }
+
+    /* Warm start for the pressure projection. The pressure is only used as
+    the initial guess of the projection which follows this event, so it is 
+    replaced by a linear extrapolation from the previous two steps */
+    if (PRESSURE_EXTRAPOLATION) {
+        if (pressure_dt_previous > 0.) {
+            double ratio = min(dt / pressure_dt_previous, 1.);
+            foreach() {
+                double p_current = p[];
+                p[] += ratio * (p[] - p_previous[]);
+                p_previous[] = p_current;
+            }
+        } else {
+            foreach() {
+                p_previous[] = p[];
+            }
+        }
+        pressure_dt_previous = dt;
+    }
+}
+
+
+event solver_tolerance (i++) {
+/* Sets the tolerance and maximum iterations of the Poisson solvers for the
+next step. Plate-force accuracy matters only near and after impact, so if
+TOLERANCE_SCHEDULE is set the tolerance is relaxed while the droplet is far 
+from the plate, and again after FINE_TOLERANCE_END_TIME, unless close to the
+pinch-off of the entrapped bubble */
+    if (TOLERANCE_SCHEDULE) {
+        // Gap between the bottom of the droplet and the plate, which is only
+        // needed before impact
+        if (t < IMPACT_TIME) {
+            drop_gap = HUGE;
+            foreach(reduction(min:drop_gap)) {
+                if (f[] > 0.5) {
+                    drop_gap = min(drop_gap, x - Delta / 2.);
+                }
+            }
+        } else {
+            drop_gap = 0.;
+        }
+
+        bool fine = (drop_gap < FINE_TOLERANCE_GAP) \
+            && (t < FINE_TOLERANCE_END_TIME);
+        if ((pinch_off_time > 0.) && (t < pinch_off_time + PINCH_OFF_WINDOW)) {
+            fine = true;
+        }
+
+        TOLERANCE = fine ? fine_tolerance : COARSE_TOLERANCE;
+        NITERMAX = fine ? fine_nitermax : COARSE_NITERMAX;
+    }
 }
 
 
+#if DIAGNOSTIC_SAMPLING
+event small_droplet_removal (i++) {
+#else
 event small_droplet_removal (t += 1e-4) { 
+#endif
 /* Removes any small droplets or bubbles that have formed, that are smaller than
  a specific size. Uses the remove_droplets_region code to leave the area near 
  the point of impact alone in order to properly resolve the entrapped bubble */
 
+    // With diagnostic sampling, only runs on the first step after every 1e-4
+    #if DIAGNOSTIC_SAMPLING
+    if (!sample_due(&next_removal_time, 1e-4)) return 0;
+    #endif
+
     // Minimum diameter (in cells) a droplet/bubble has to be, else it will be 
     // removed
     int drop_min_cell_width = 36;
@@ -331,7 +631,10 @@ event small_droplet_removal (t += 1e-4) {
     double ignore_region_x_limit = 0.1; 
     double ignore_region_y_limit = 0.1; 
     
-    // Counts the number of bubbles there are using the tag function
+    // Counts the number of bubbles there are using the tag function. The tag
+    // field is then reused to tag the droplets and bubbles that are removed,
+    // so the event needs one field slot rather than two
+    scalar bubbles[];
     foreach() {
         bubbles[] = 1. - f[] > drop_thresh;
     }
@@ -368,13 +671,23 @@ event small_droplet_removal (t += 1e-4) {
 
         // Determine the area of all of the entrapped air cells, which will have
         // a tag not equal to 0 (which will be liquid) or air_tag, which is the
-        // tag of the surrounding air
+        // tag of the surrounding air, along with their centroid
         bubble_area = 0.;
-        foreach(reduction(+:bubble_area)) {
+        double bubble_x = 0., bubble_y = 0.;
+        foreach(reduction(+:bubble_area) reduction(+:bubble_x) \
+                reduction(+:bubble_y)) {
             if ((bubbles[] > 0) && (bubbles[] != air_tag)) {
-                bubble_area += (1. - f[]) * dv();
+                double air_volume = (1. - f[]) * dv();
+                bubble_area += air_volume;
+                bubble_x += x * air_volume;
+                bubble_y += y * air_volume;
             }
         }
+        bubble_area_time = t;
+        if (bubble_area > 0.) {
+            bubble_centroid_x = bubble_x / bubble_area;
+            bubble_centroid_y = bubble_y / bubble_area;
+        }
 
         /* After the removal delay, remove drops and bubbles as necessary */    
         if (t >= pinch_off_time + REMOVAL_DELAY) {
@@ -387,20 +700,20 @@ event small_droplet_removal (t += 1e-4) {
 
             if (t < 0.3) {
                 // Remove droplets outside of the specified region
-                remove_droplets_region(remove_struct, ignore_region_x_limit, \
-                    ignore_region_y_limit);
+                remove_droplets_region(remove_struct, bubbles, \
+                    ignore_region_x_limit, ignore_region_y_limit);
 
                 // Remove bubbles outside of the specified region
                 remove_struct.bubbles = true;
                 remove_struct.minsize = bubble_min_cell_width;
-                remove_droplets_region(remove_struct, ignore_region_x_limit, \
-                    ignore_region_y_limit);
+                remove_droplets_region(remove_struct, bubbles, \
+                    ignore_region_x_limit, ignore_region_y_limit);
             } else {
-                remove_droplets_region(remove_struct, 0, 0);
+                remove_droplets_region(remove_struct, bubbles, 0, 0);
                 
                 remove_struct.bubbles = true;
                 remove_struct.minsize = bubble_min_cell_width;
-                remove_droplets_region(remove_struct, 0, 0);
+                remove_droplets_region(remove_struct, bubbles, 0, 0);
             }
 
             // Remove the entrapped bubble if specified
@@ -417,14 +730,18 @@ event small_droplet_removal (t += 1e-4) {
 }
 
 
+#if ADAPTIVE_OUTPUT
+event output_plate (i++) {
+#else
 event output_plate (t += PLATE_OUTPUT_TIMESTEP) {
+#endif
 /* Outputs data along the plate */
 
-    if ((t >= START_OUTPUT_TIME) && (t <= END_OUTPUT_TIME)) {
+    if (output_due(&plate_schedule)) {
         // Creates the file for outputting data along the plate
         char plate_output_filename[80];
         sprintf(plate_output_filename, "plate_output_%d.txt", plate_output_no);
-        FILE *plate_output_file = fopen(plate_output_filename, "w");
+        FILE *plate_output_file = output_open(plate_output_filename, "w");
 
         // Adds the time to the first line of the file
         fprintf(plate_output_file, "t = %g\n", t);
@@ -444,12 +761,51 @@ event output_plate (t += PLATE_OUTPUT_TIMESTEP) {
         }
 
         // Close plate output file
-        fclose(plate_output_file);
+        output_close(plate_output_file);
         plate_output_no++; // Increments output number
     }
 }
 
 
+#if DIAGNOSTIC_SAMPLING
+event output_log (i++) {
+/* Outputs data about the general flow. The quantities are linearly 
+interpolated between solver steps to every multiple of LOG_OUTPUT_TIMESTEP, so
+the log has the same times as without diagnostic sampling. The bubble area is
+only updated every 1e-4, so is held rather than interpolated, taking the new
+value for the log times at or after its update */
+    double log_current[8] = {current_force, force_term, previous_avg, \
+        previous_std, s_current, ds_dt, d2s_dt2, bubble_area};
+
+    if (log_t_previous < 0.) {
+        // The first step has nothing to interpolate from
+        for (int j = 0; j < 8; j++) log_previous[j] = log_current[j];
+    }
+
+    while (next_log_time <= t) {
+        double t_log = next_log_time;
+        double w = t > log_t_previous \
+            ? (t_log - log_t_previous) / (t - log_t_previous) : 1.;
+        w = clamp(w, 0., 1.);
+        double v[8];
+        for (int j = 0; j < 7; j++) {
+            v[j] = (1. - w) * log_previous[j] + w * log_current[j];
+        }
+        v[7] = t_log >= bubble_area_time ? log_current[7] : log_previous[7];
+
+        if ((t_log >= START_OUTPUT_TIME) && (t_log <= END_OUTPUT_TIME)) {
+            fprintf(stderr, \
+                "t = %.4f, F = %.6f, force_term = %.6f, avg = %.6f, std = %.6f, s = %g, ds_dt = %g, d2s_dt2 = %g, bubble_area = %.7f\n", \
+                t_log, v[0], v[1], v[2], v[3], v[4], v[5], v[6], v[7]);
+        }
+        next_log_time += LOG_OUTPUT_TIMESTEP;
+    }
+
+    // Stores the values of this step to interpolate from in the next step
+    for (int j = 0; j < 8; j++) log_previous[j] = log_current[j];
+    log_t_previous = t;
+}
+#else
 event output_log (t += LOG_OUTPUT_TIMESTEP) {
 /* Outputs data about the general flow */
     if ((t >= START_OUTPUT_TIME) && (t <= END_OUTPUT_TIME)) {
@@ -460,48 +816,121 @@ event output_log (t += LOG_OUTPUT_TIMESTEP) {
             s_current, ds_dt, d2s_dt2, bubble_area);
     }
 }
+#endif
 
 
+#if ADAPTIVE_OUTPUT
+event output_interface (i++) {
+#else
 event output_interface (t += INTERFACE_OUTPUT_TIMESTEP) {
+#endif
 /* Outputs the interface locations of the droplet */
-    if ((t >= START_OUTPUT_TIME) && (t <= END_OUTPUT_TIME)) {
+    if (output_due(&interface_schedule)) {
         // Creates text file to save output to
         char interface_filename[80];
         sprintf(interface_filename, "interface_%d.txt", interface_output_no);
-        FILE *interface_file = fopen(interface_filename, "w");
+        FILE *interface_file = output_open(interface_filename, "w");
 
         // Outputs the interface locations and closes the file
         output_facets(f, interface_file);
-        fclose(interface_file);
+        output_close(interface_file);
 
         // Appends the interface time file with the time and plate position (0)
-        FILE *interface_time_file = fopen(interface_time_filename, "a");
+        FILE *interface_time_file = output_open(interface_time_filename, "a");
         fprintf(interface_time_file, "%d, %g, %g\n", \
             interface_output_no, t, 0.);
-        fclose(interface_time_file);
+        output_close(interface_time_file);
 
         interface_output_no++;
     }
 }
 
 
+#if ADAPTIVE_OUTPUT
+event roi_output (i++) {
+#else
+event roi_output (t += ROI_OUTPUT_TIMESTEP) {
+#endif
+/* Outputs the fields at the native resolution of the grid inside a square
+window of half-width ROI_HALF_WIDTH, which follows the region of interest 
+chosen by ROI_TRACK. This resolves the turnover point, jet or entrapped bubble
+at every output without writing the whole grid */
+    if (ROI_TRACK == 0) return 0;
+
+    // The region may not exist yet, e.g. the bubble before pinch-off
+    double xc, yc;
+    if (!roi_centre(&xc, &yc)) return 0;
+
+    if (output_due(&roi_schedule)) {
+        char roi_filename[80];
+        sprintf(roi_filename, "roi_output_%d.txt", roi_output_no);
+        FILE * roi_file = output_open(roi_filename, "w");
+        fprintf(roi_file, "# 1:x 2:y 3:p 4:f 5:u.x 6:u.y 7:delta\n");
+
+        // Parent cells outside the window are skipped along with their 
+        // children, so only the part of the tree in the window is visited
+        foreach_cell() {
+            if ((fabs(x - xc) > ROI_HALF_WIDTH + Delta / 2.) \
+                    || (fabs(y - yc) > ROI_HALF_WIDTH + Delta / 2.)) {
+                continue;
+            }
+            if (is_leaf(cell)) {
+                fprintf(roi_file, "%g %g %g %g %g %g %g\n", \
+                    x, y, p[], f[], u.x[], u.y[], Delta);
+                continue;
+            }
+        }
+        output_close(roi_file);
+
+        // Appends the time and centre of the window to the times file
+        FILE * roi_time_file = output_open("roi_times.txt", "a");
+        fprintf(roi_time_file, "%d, %g, %g, %g\n", roi_output_no, t, xc, yc);
+        output_close(roi_time_file);
+
+        roi_output_no++;
+    }
+}
+
+
+#if ADAPTIVE_OUTPUT
+event gfs_output (i++) {
+#else
 event gfs_output (t += GFS_OUTPUT_TIMESTEP) {
+#endif
 /* Saves a gfs file */
-    if ((t >= START_OUTPUT_TIME) && (t <= END_OUTPUT_TIME)) {
+    if (output_due(&gfs_schedule)) {
+        // The times are no longer evenly spaced with the adaptive cadence
+        #if ADAPTIVE_OUTPUT
+        FILE * gfs_time_file = output_open("gfs_output_times.txt", "a");
+        fprintf(gfs_time_file, "%d, %g, %g\n", gfs_output_no, t, s_current);
+        output_close(gfs_time_file);
+        #endif
+
+        // Output a compressed snapshot in place of the gfs and field files
+        if (COMPRESSED_OUTPUT) {
+            char compressed_filename[80];
+            sprintf(compressed_filename, "field_output_%d.cmp", gfs_output_no);
+            output_compressed(compressed_filename);
+            gfs_output_no++;
+            return 0;
+        }
+
         // Output gfs file
         char gfs_filename[80];
         sprintf(gfs_filename, "gfs_output_%d.gfs", gfs_output_no);
-        output_gfs(file = gfs_filename);
+        FILE * gfs_file = output_open(gfs_filename, "w");
+        output_gfs(fp = gfs_file);
+        output_close(gfs_file);
 
         // Output fields
         char field_filename[80];
         sprintf(field_filename, "field_output_%d.txt", gfs_output_no);
-        FILE *field_file = fopen(field_filename, "w");
+        FILE *field_file = output_open(field_filename, "w");
 
         int N_output = (int) floor(pow(2, MAXLEVEL) * 2. / 6.);
         output_field ({p,f,u}, field_file, N_output, box = {{0,0},{2.5,2.5}});
 
-        fclose(field_file);
+        output_close(field_file);
 
         gfs_output_no++;
     }
@@ -510,72 +939,95 @@ event gfs_output (t += GFS_OUTPUT_TIMESTEP) {
 
 event movies (t += 1e-3) {
 /* Produces movies using bview */ 
-    if (MOVIES) {
-        // Creates a string with the time to put on the plots
-        char time_str[80];
-        sprintf(time_str, "t = %g\n", t);
 
-        /* Zoomed out view */
-        // Set up bview box
-        view (width = 1024, height = 1024, fov = 9, ty = -0.235, tx = -0.235, \
-            quat = {0, 0, -0.707, 0.707});
+    /* Snapshots for the offline renderer in video_production/renderer, which
+    only store the fields that are rendered. The snapshot times and plate 
+    positions are appended to snapshot_times.txt */
+    if (MOVIE_SNAPSHOTS) {
+        char snapshot_filename[80];
+        sprintf(snapshot_filename, "snapshot_%d", snapshot_no);
+        if (ARCHIVE_OUTPUT) {
+            FILE * snapshot_file = output_open(snapshot_filename, "w");
+            dump(fp = snapshot_file, list = (scalar *){f, p, u});
+            output_close(snapshot_file);
+        } else {
+            dump(file = snapshot_filename, list = (scalar *){f, p, u});
+        }
+
+        FILE * snapshot_time_file = output_open("snapshot_times.txt", "a");
+        fprintf(snapshot_time_file, "%d, %g, %g\n", snapshot_no, t, s_current);
+        output_close(snapshot_time_file);
+        snapshot_no++;
+    }
+
+    /* The rendering is compiled out without MOVIES, so the simulation does
+    not need the GL libraries */
+    #if MOVIES
+    // Creates a string with the time to put on the plots
+    char time_str[80];
+    sprintf(time_str, "t = %g\n", t);
+
+    /* Zoomed out view */
+    // Set up bview box
+    view (width = 1024, height = 1024, fov = 9, ty = -0.235, tx = -0.235, \
+        quat = {0, 0, -0.707, 0.707});
+
+    /* Movie of the volume fraction of the droplet */
+    clear();
+    mirror({0, 1}) {
+        draw_vof("f", lw = 2);
+        squares("f", linear = true, spread = -1, linear = true, map = cool_warm); 
+    }
+    draw_string(time_str, pos=1, lc= { 0, 0, 0 }, lw=2);
+    save ("tracer.mp4");
 
-        /* Movie of the volume fraction of the droplet */
+    /* Pressure video, scaled by the stationary Wagner maximum */
+    for (int pcoeff = 0; pcoeff <= 4; pcoeff++) {
         clear();
         mirror({0, 1}) {
             draw_vof("f", lw = 2);
-            squares("f", linear = true, spread = -1, linear = true, map = cool_warm); 
-        }
-        draw_string(time_str, pos=1, lc= { 0, 0, 0 }, lw=2);
-        save ("tracer.mp4");
-
-        /* Pressure video, scaled by the stationary Wagner maximum */
-        for (int pcoeff = 0; pcoeff <= 4; pcoeff++) {
-            clear();
-            mirror({0, 1}) {
-                draw_vof("f", lw = 2);
-                if (t <= IMPACT_TIME) {
-                    squares("p", min = 0, linear = false, spread = -1, linear = true, map = cool_warm);
-                } else {
-                    double wagner_pmax = 3 / (8 * (t - IMPACT_TIME));
-                    squares("p", min = 0, max = wagner_pmax * (1 + 0.25 * pcoeff), linear = false, spread = -1, linear = true, map = cool_warm);
-                }
-            }
-            char pressure_vid_filename[80];
-            sprintf(pressure_vid_filename, "pressure_%d.mp4", pcoeff);
-            save (pressure_vid_filename);
-        }
-
-        /* Velocity videos. Aim is for each velocity component and norm, produce multiple videos with
-        different (fixed) colour maps */
-        for (int velmax = 1; velmax <= 3; velmax++) {
-            /* Movie of vertical velocity */
-            int velmax = 2;
-            clear();
-            mirror({0, 1}) {
-                draw_vof("f", lw = 2);
-                squares("u.x", min = -velmax, max = velmax, linear = false, spread = -1, linear = true, map = cool_warm);
-            }
-            // draw_string(time_str, pos=1, lc= { 0, 0, 0 }, lw=2);
-
-            char vertical_vid_filename[80];
-            sprintf(vertical_vid_filename, "vertical_vel_%d.mp4", velmax);
-            save (vertical_vid_filename);
-
-            /* Movie of horizontal velocity */
-            velmax = 3;
-            clear();
-            mirror({0, 1}) {
-                draw_vof("f", lw = 2);
-                squares("u.y", min = -velmax, max = velmax, linear = false, spread = -1, linear = true, map = cool_warm);
+            if (t <= IMPACT_TIME) {
+                squares("p", min = 0, linear = false, spread = -1, linear = true, map = cool_warm);
+            } else {
+                double pmax = wagner_pmax(t - IMPACT_TIME, 0., 0., 1.);
+                squares("p", min = 0, max = pmax * (1 + 0.25 * pcoeff), linear = false, spread = -1, linear = true, map = cool_warm);
             }
-            // draw_string(time_str, pos=1, lc= { 0, 0, 0 }, lw=2);
+        }
+        char pressure_vid_filename[80];
+        sprintf(pressure_vid_filename, "pressure_%d.mp4", pcoeff);
+        save (pressure_vid_filename);
+    }
 
-            char horizontal_vid_filename[80];
-            sprintf(horizontal_vid_filename, "horizontal_vel_%d.mp4", velmax);
-            save (horizontal_vid_filename);
+    /* Velocity videos. Aim is for each velocity component and norm, produce multiple videos with
+    different (fixed) colour maps */
+    for (int velmax = 1; velmax <= 3; velmax++) {
+        /* Movie of vertical velocity */
+        int velmax = 2;
+        clear();
+        mirror({0, 1}) {
+            draw_vof("f", lw = 2);
+            squares("u.x", min = -velmax, max = velmax, linear = false, spread = -1, linear = true, map = cool_warm);
         }
+        // draw_string(time_str, pos=1, lc= { 0, 0, 0 }, lw=2);
+
+        char vertical_vid_filename[80];
+        sprintf(vertical_vid_filename, "vertical_vel_%d.mp4", velmax);
+        save (vertical_vid_filename);
+
+        /* Movie of horizontal velocity */
+        velmax = 3;
+        clear();
+        mirror({0, 1}) {
+            draw_vof("f", lw = 2);
+            squares("u.y", min = -velmax, max = velmax, linear = false, spread = -1, linear = true, map = cool_warm);
+        }
+        // draw_string(time_str, pos=1, lc= { 0, 0, 0 }, lw=2);
+
+        char horizontal_vid_filename[80];
+        sprintf(horizontal_vid_filename, "horizontal_vel_%d.mp4", velmax);
+        save (horizontal_vid_filename);
     }
+    #endif
 }
 
 
@@ -588,22 +1040,309 @@ event logstats (t += 0.01) {
     fprintf(fp_stats, "i: %i t: %g dt: %g #Cells: %ld Wall clock time (s): %g CPU time (s): %g \n", \
         i, t, dt, grid->n, perf.t, s.cpu);
     fflush(fp_stats);
+
+    if (MEMORY_STATS) {
+        memory_report(fp_memory);
+    }
+
+    // Writes the open output files into the run archive, so they are kept if 
+    // the run is killed
+    if (ARCHIVE_OUTPUT) {
+        archive_sync(&archive, t);
+    }
+}
+
+
+event solver_stats (i++) {
+/* Outputs the number of iterations and residuals of the multigrid solvers for
+the pressure projection (mgp), the approximate projection of the face 
+velocities (mgpf) and the viscous term (mgu), as well as the wall time of the
+step. Warns in the log if any solver hits the maximum number of iterations */
+    if (SOLVER_STATS) {
+        double current_wall_time = omp_get_wtime();
+        double step_time = step_wall_time > 0. \
+            ? current_wall_time - step_wall_time : 0.;
+        step_wall_time = current_wall_time;
+
+        fprintf(fp_solver, "i: %d t: %g dt: %g mgp: %d %g %g mgpf: %d %g %g mgu: %d %g %g added_mass: %g Step time (s): %g\n", \
+            i, t, dt, mgp.i, mgp.resb, mgp.resa, mgpf.i, mgpf.resb, \
+            mgpf.resa, mgu.i, mgu.resb, mgu.resa, added_mass_correction, \
+            step_time);
+
+        if (mgp.i >= NITERMAX || mgpf.i >= NITERMAX || mgu.i >= NITERMAX) {
+            fprintf(stderr, \
+                "WARNING: NITERMAX reached at i = %d, t = %g (mgp: %d, mgpf: %d, mgu: %d)\n", \
+                i, t, mgp.i, mgpf.i, mgu.i);
+        }
+    }
+}
+
+
+event live_metrics (i++) {
+/* Rewrites the metrics file metrics.prom every METRICS_INTERVAL wall seconds,
+and answers any pending requests to the HTTP endpoint. The file is written to 
+a temporary file and renamed, so a reader never sees a partial file */
+    if (METRICS_INTERVAL > 0.) {
+        double wall_time = omp_get_wtime();
+        if (metrics_wall_time < 0.) {
+            metrics_wall_time = wall_time;
+            metrics_t = t;
+            metrics_i = i;
+        } else if (wall_time - metrics_wall_time >= METRICS_INTERVAL) {
+            // Rates over the last interval
+            double elapsed = wall_time - metrics_wall_time;
+            metrics_step_rate = (i - metrics_i) / elapsed;
+            double time_rate = (t - metrics_t) / elapsed;
+            metrics_eta = time_rate > 0. ? (MAX_TIME - t) / time_rate : -1.;
+            metrics_wall_time = wall_time;
+            metrics_t = t;
+            metrics_i = i;
+
+            FILE * fp = fopen("metrics.prom.tmp", "w");
+            if (fp != NULL) {
+                metrics_write(fp);
+                fclose(fp);
+                rename("metrics.prom.tmp", "metrics.prom");
+            }
+        }
+    }
+
+    if (metrics_socket >= 0) {
+        metrics_serve();
+    }
+}
+
+
+event tracer_advection (i++) {
+/* Writes the tracers to the trajectory stream every TRACER_OUTPUT_TIMESTEP, 
+then moves them over the coming step. The jet is seeded TRACER_JET_DELAY after
+impact, in the liquid around the turnover point of Wagner theory */
+    if (TRACER_NO == 0) return 0;
+
+    if (!jet_tracers_seeded && (t >= IMPACT_TIME + TRACER_JET_DELAY)) {
+        #if AXISYMMETRIC
+        double d = wagner_s_dependents(t - IMPACT_TIME, s_current, ds_dt, \
+            d2s_dt2).d;
+        #else
+        // wagner.h is axisymmetric, so uses the 2D turnover point d^2 = 4 tau
+        double d = 2. * sqrt(max(t - IMPACT_TIME - s_current, 0.));
+        #endif
+        tracers_seed(X0, X0 + 2. * TRACER_JET_WIDTH, \
+            max(Y0, Y0 + d - TRACER_JET_WIDTH), Y0 + d + TRACER_JET_WIDTH, \
+            true);
+        jet_tracers_seeded = true;
+    }
+
+    if ((t >= START_OUTPUT_TIME) && (t <= END_OUTPUT_TIME) \
+            && sample_due(&next_tracer_time, TRACER_OUTPUT_TIMESTEP)) {
+        tracer_write_frame(fp_tracers, &tracers, t);
+    }
+    if (tracers.n == 0) return 0;
+
+    // Each leaf cell moves the tracers in its own range of keys. The ranges
+    // are disjoint, so the cells are updated in parallel
+    foreach() {
+        int shift = 2 * (MAXLEVEL - level);
+        uint64_t first = tracer_morton((uint32_t) ((x - X0) / Delta), \
+            (uint32_t) ((y - Y0) / Delta)) << shift;
+        uint64_t last = first + ((uint64_t) 1 << shift);
+        for (int k = tracer_find(&tracers, first); \
+                (k < tracers.n) && (tracers.p[k].key < last); k++) {
+            tracer * tr = &tracers.p[k];
+
+            // Midpoint rule, where the midpoint is less than a cell away by
+            // the CFL condition so is interpolated from the same stencil
+            double x_mid = tr->x \
+                + dt / 2. * tracer_velocity(point, u.x, tr->x, tr->y);
+            double y_mid = tr->y \
+                + dt / 2. * tracer_velocity(point, u.y, tr->x, tr->y);
+            tr->x += dt * tracer_velocity(point, u.x, x_mid, y_mid);
+            tr->y += dt * tracer_velocity(point, u.y, x_mid, y_mid);
+        }
+    }
+
+    // Restores the order for the new positions, dropping any tracers which
+    // have left the domain
+    for (int k = 0; k < tracers.n; k++) {
+        tracers.p[k].key = tracer_key(tracers.p[k].x, tracers.p[k].y, X0, Y0, \
+            L0, MAXLEVEL);
+    }
+    tracer_sort(&tracers);
+}
+
+
+event plugin_step (i++) {
+/* Calls the step hooks of the analysis plugins */
+    plugins_call(PLUGIN_STEP);
 }
 
 
 event end (t = MAX_TIME) {
 /* Ends the simulation */ 
 
+    plugins_call(PLUGIN_END);
+
     end_wall_time = omp_get_wtime(); // Records the time of finish
 
     fprintf(stderr, "Finished after %g seconds\n", \
         end_wall_time - start_wall_time);
 
+    // Performance summary, which is read by the benchmark suite
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    fprintf(stderr, \
+        "Performance: steps = %d, cell_updates = %ld, wall_time = %g, peak_rss_kb = %ld\n", \
+        i, perf.tnc, end_wall_time - start_wall_time, usage.ru_maxrss);
+
     if (PEAK_DETECT) {
         free(filtered_forces);
     }
+
+    if (PRESSURE_EXTRAPOLATION) {
+        delete ({p_previous});
+    }
+}
+
+/* Force on the plate, integrating the pressure field (and the viscous stress
+if viscous is true) along the plate using the trapezoidal rule */
+double plate_force(scalar pressure, bool viscous) {
+    double force = 0.; // Initialise to be zero
+
+    // Iterates over the solid boundary
+    foreach_boundary(left, reduction(+:force)) {
+        if (y < PLATE_WIDTH) {
+            double viscous_stress = 0.;
+            if (viscous) {
+                // Viscosity average in the cell above the plate
+                double avg_mu = f[] * (mu1 - mu2) + mu2;
+
+                // Viscous stress in the cell above the plate
+                viscous_stress = - 2 * avg_mu * (u.x[1, 0] - u.x[]) / Delta;
+            }
+
+            // Adds the contribution to the force using trapeze rule, depending 
+            // on if we are in the axisymmetric setting or not
+            #if AXISYMMETRIC
+            force += y * Delta * (pressure[] + viscous_stress);
+            #else
+            force += Delta * (pressure[] + viscous_stress);
+            #endif
+        }
+    }
+
+    // Integrates about angular part in axisymmetric, or doubles in 2D to take 
+    // into account the other side of the plate
+    #if AXISYMMETRIC
+    force = 2 * pi * force; 
+    #else
+    force = 2 * force; 
+    #endif
+
+    return force;
+}
+
+
+/* Plate ODE. Returns the plate position after a step of size h_next, given
+the force on the plate and that the previous step had size h_previous. Uses
+second-order finite differences, which for unequal step sizes (with diagnostic
+sampling) are the non-uniform versions of the central differences */
+double plate_position(double force, double h_next, double h_previous) {
+    if (h_next == h_previous) {
+        double h = h_next;
+        return (h * h * force \
+            + (2. * ALPHA - h * h * GAMMA) * s_current \
+            - (ALPHA - h * BETA / 2.) * s_previous) \
+            / (ALPHA + h * BETA / 2.);
+    }
+
+    double h_sum = h_next + h_previous;
+    return (force - GAMMA * s_current \
+        + 2. * ALPHA * (s_current / h_next \
+            + (s_current - s_previous) / h_previous) / h_sum \
+        - BETA * ((h_next * h_next - h_previous * h_previous) * s_current \
+            - h_next * h_next * s_previous) / (h_next * h_previous * h_sum)) \
+        / ((2. * ALPHA + BETA * h_previous) / (h_next * h_sum));
 }
 
+
+/* First and second derivatives of s at the current time given the next
+position s_new, as second-order central differences over the steps h_previous
+and h_next, which may differ */
+double plate_velocity(double s_new, double h_next, double h_previous) {
+    return (h_previous * h_previous * s_new - h_next * h_next * s_previous \
+        + (h_next * h_next - h_previous * h_previous) * s_current) \
+        / (h_next * h_previous * (h_next + h_previous));
+}
+
+double plate_acceleration(double s_new, double h_next, double h_previous) {
+    if (h_next == h_previous) {
+        return (s_new - 2 * s_current + s_previous) / (h_next * h_next);
+    }
+    return 2. * ((s_new - s_current) / h_next \
+        - (s_current - s_previous) / h_previous) / (h_next + h_previous);
+}
+
+
+/* Implicit added mass correction. For light plates (small ALPHA), the 
+explicit coupling between the force and the plate acceleration is unstable, as
+the fluid acts as an added mass on the plate. Here the force is instead made 
+consistent with the plate acceleration at the end of the step. 
+
+The pressure depends linearly on the acceleration of the frame, so the 
+pressure response to a unit acceleration, p_a, is found with one extra 
+projection. The force for a plate acceleration a is then 
+F(a) = force + F_a (a - a_fluid), where F_a is the force from p_a and a_fluid 
+is the acceleration the fluid step was computed with. The plate acceleration 
+from the ODE is affine in the force, a = a_0 + c (F - force), so the 
+consistent acceleration is solved for directly as
+a = (a_0 - c F_a a_fluid) / (1 - c F_a), and F(a) is returned. This corrects 
+the force only: the fluid fields are not re-solved within the step, so the 
+corrected acceleration is used by the fluid from the next step onwards. */
+double coupled_force(double force, double h_next, double h_previous) {
+    /* Pressure response to a unit acceleration of the frame, with the same
+    boundary conditions as the pressure */
+    scalar p_a[];
+    face vector u_a[];
+    p_a[right] = FAR_FIELD_BC ? far_field(x) : dirichlet(0.);
+    p_a[top] = FAR_FIELD_BC ? far_field(y) : dirichlet(0.);
+    p_a[left] = neumann(- fm.n[] / alpha.n[]);
+    foreach() {
+        p_a[] = 0.;
+    }
+    foreach_face(x) {
+        u_a.x[] = fm.x[] * dt;
+    }
+    foreach_face(y) {
+        u_a.y[] = 0.;
+    }
+    boundary ((scalar *){u_a});
+    project(u_a, p_a, alpha, dt);
+    double force_acc = plate_force(p_a, false);
+
+    /* Acceleration a_0 without the correction, and its change per unit 
+    force c */
+    double acc_fluid = d2s_dt2; // Acceleration used in the fluid step
+    double acc_0 = plate_acceleration(plate_position(force, h_next, \
+        h_previous), h_next, h_previous);
+    double c = plate_acceleration(plate_position(force + 1., h_next, \
+        h_previous), h_next, h_previous) - acc_0;
+
+    // The added mass resists the acceleration (F_a < 0), so this is positive
+    double denominator = 1. - c * force_acc;
+    if (denominator <= 0.) {
+        fprintf(stderr, \
+            "WARNING: No added mass correction at t = %g (F_a = %g)\n", t, \
+            force_acc);
+        added_mass_correction = 0.;
+        return force;
+    }
+    double acc = (acc_0 - c * force_acc * acc_fluid) / denominator;
+    added_mass_correction = force_acc * (acc - acc_fluid);
+
+    return force + added_mass_correction;
+}
+
+
 /* Peak detect algorithm */
 void peak_detect(double current_force) {
     /* Peak detection. We attempt to use a peak detection algorithm to check if 
@@ -644,29 +1383,33 @@ void peak_detect(double current_force) {
                 /* If current force is less than or equal to zero, or 
                 differs from the previous force by more than 25%, then 
                 completely ignore */
-                force_term = filtered_forces[PEAK_LAG - 1];
+                force_term = wagner_prediction(filtered_forces[PEAK_LAG - 1]);
                 new_filtered = force_term;
+                force_peak_time = t;
 
                 // Output the force data
-                FILE * interp_stats_file = fopen(interp_stats_filename, "a");
+                FILE * interp_stats_file = output_open(interp_stats_filename, "a");
                 fprintf(interp_stats_file, "t = %g, F = %g, avgFilter = %g, stdFilter = %g, force_term = %g\n", \
                     t, current_force, avgFilter, stdFilter, force_term);
-                fclose(interp_stats_file);
+                output_close(interp_stats_file);
             } else if (fabs(current_force - avgFilter) > PEAK_THRESHOLD * stdFilter) {
                 /* If current force deviates from the mean more than 
                 PEAK_THRESHOLD number of standard deviations, then take 
                 force term to be an influenced value */
 
-                force_term = avgFilter;
+                force_term = WAGNER_PREDICTOR \
+                    ? wagner_prediction(filtered_forces[PEAK_LAG - 1]) \
+                    : avgFilter;
                     
                 new_filtered = PEAK_INFLUENCE * current_force \
                     + (1 - PEAK_INFLUENCE) * filtered_forces[PEAK_LAG - 1];
+                force_peak_time = t;
 
                 // Output the force data
-                FILE * interp_stats_file = fopen(interp_stats_filename, "a");
+                FILE * interp_stats_file = output_open(interp_stats_filename, "a");
                 fprintf(interp_stats_file, "t = %g, F = %g, avgFilter = %g, stdFilter = %g, force_term = %g\n", \
                     t, current_force, avgFilter, stdFilter, force_term);
-                fclose(interp_stats_file);
+                output_close(interp_stats_file);
             } else {
                 /* Else current_force is kept */
                 force_term = current_force;
@@ -707,10 +1450,453 @@ void peak_detect(double current_force) {
 }
 
 
-/* Alternative remove_droplets definition */
-void remove_droplets_region(struct RemoveDroplets p,\
+/* Wagner theory composite force for the current plate motion. The model is
+only for axisymmetric impacts, so is zero in 2D */
+double wagner_force() {
+    #if AXISYMMETRIC
+    return wagner_composite_force(t - IMPACT_TIME, s_current, ds_dt, \
+        d2s_dt2, 1.);
+    #else
+    return 0.;
+    #endif
+}
+
+
+/* Prediction of the force from the last accepted force, used by the peak
+detection to replace a rejected force. With WAGNER_PREDICTOR the last force is
+scaled by the change in the Wagner force since the previous plate step, so a 
+replaced force follows the expected growth rather than holding its value */
+double wagner_prediction(double previous_force) {
+    if (WAGNER_PREDICTOR && (wagner_force_previous > 0.) \
+            && (wagner_force_current > 0.)) {
+        return previous_force * wagner_force_current / wagner_force_previous;
+    }
+    return previous_force;
+}
+
+
+/* Initial condition of a spherical droplet falling downwards */
+void initial_condition() {
+    /* Refines around the droplet */
+    refine(sq(x - DROP_CENTRE) + sq(y) < sq(DROP_RADIUS + DROP_REFINED_WIDTH) \
+        && sq(x - DROP_CENTRE) + sq(y) > sq(DROP_RADIUS - DROP_REFINED_WIDTH) \
+        && level < MAXLEVEL);
+    
+    /* Initialises the droplet volume fraction */
+    fraction(f, -sq(x - DROP_CENTRE) - sq(y) + sq(DROP_RADIUS));
+
+    /* Initialise the droplet velocity downwards */
+    foreach() {
+        u.x[] = DROP_VEL * f[];
+    }
+    boundary ((scalar *){u});
+}
+
+
+/* Adaptive refinement criteria of the grid */
+void adapt_grid() {
+    /* Adapts with respect to velocities and volume fraction */
+    adapt_wavelet ({u.x, u.y, f}, (double[]){1e-3, 1e-3, 1e-6}, 
+        minlevel = MINLEVEL, maxlevel = MAXLEVEL);
+    
+    /* Refines above the plate */
+    refine((y < PLATE_WIDTH) && (x <= PLATE_REFINED_WIDTH) \
+        && level < MAXLEVEL);
+}
+
+
+/* Preflight mode. Builds the initial grid with the same initial condition and
+refinement criteria as a run, without any time-stepping, and writes the number
+of cells on each level and the memory used to preflight.txt. The cost of the
+run is then estimated from this by utility_scripts/preflight.sh */
+void preflight() {
+    double preflight_start = omp_get_wtime();
+
+    /* The VOF defaults event is not run without run(), so the refinement of 
+    the volume fraction is set here as vof.h would */
+    f.refine = f.prolongation = fraction_refine;
+
+    /* Adapts until the grid stops changing, as the refinement event would 
+    over the first steps */
+    initial_condition();
+    long previous_cells = -1;
+    int adapt_no = 0;
+    while ((grid->n != previous_cells) && (adapt_no < 20)) {
+        previous_cells = grid->n;
+        adapt_grid();
+        adapt_no++;
+    }
+
+    /* Number of leaf cells on each level, and of all cells in the tree */
+    long level_cells[MAXLEVEL + 1];
+    for (int l = 0; l <= MAXLEVEL; l++) level_cells[l] = 0;
+    long total_cells = 0;
+    foreach_cell() {
+        total_cells++;
+        if (is_leaf(cell)) {
+            level_cells[level]++;
+            continue;
+        }
+    }
+
+    int field_no = 0;
+    for (scalar s in all) {
+        field_no++;
+    }
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    FILE * fp = fopen("preflight.txt", "w");
+    fprintf(fp, "MAXLEVEL = %d\n", MAXLEVEL);
+    fprintf(fp, "leaf_cells = %ld\n", grid->n);
+    fprintf(fp, "total_cells = %ld\n", total_cells);
+    fprintf(fp, "fields = %d\n", field_no);
+    fprintf(fp, "field_memory_mb = %g\n", \
+        total_cells * field_no * sizeof(double) / 1048576.);
+    fprintf(fp, "peak_rss_mb = %g\n", usage.ru_maxrss / 1024.);
+    fprintf(fp, "max_time = %g\n", MAX_TIME);
+    fprintf(fp, "adapt_iterations = %d\n", adapt_no);
+    fprintf(fp, "preflight_time = %g\n", omp_get_wtime() - preflight_start);
+    for (int l = 0; l <= MAXLEVEL; l++) {
+        if (level_cells[l] > 0) {
+            fprintf(fp, "level_%d = %ld\n", l, level_cells[l]);
+        }
+    }
+    fclose(fp);
+}
+
+
+/* Compressed snapshot of the pressure, volume fraction and velocity on the
+leaf cells of the tree, with the error bounds F_ERROR_BOUND, P_ERROR_BOUND and
+U_ERROR_BOUND. The format is described in field_codec.h, and the snapshots are
+decoded by the reader library in data_analysis/reader */
+void output_compressed(char * filename) {
+    scalar * list = {p, f, u.x, u.y};
+    codec_header header = {t, X0, Y0, L0, 4, 0, \
+        {"p", "f", "u.x", "u.y"}, \
+        {P_ERROR_BOUND, F_ERROR_BOUND, U_ERROR_BOUND, U_ERROR_BOUND}};
+
+    foreach_cell() {
+        if (is_leaf(cell)) {
+            header.leaf_no++;
+            continue;
+        }
+    }
+
+    /* Levels and values of the leaves in the order of the traversal, with the
+    values of each field stored contiguously */
+    unsigned char * levels = malloc(header.leaf_no);
+    double * values = malloc(header.field_no * header.leaf_no * sizeof(double));
+    long k = 0;
+    foreach_cell() {
+        if (is_leaf(cell)) {
+            levels[k] = level;
+            int j = 0;
+            for (scalar s in list) {
+                values[j * header.leaf_no + k] = s[];
+                j++;
+            }
+            k++;
+            continue;
+        }
+    }
+
+    FILE * fp = output_open(filename, "w");
+    codec_write(fp, &header, levels, values);
+    output_close(fp);
+    free(levels);
+    free(values);
+}
+
+
+/* Returns true if the output with the given schedule is due. Without
+ADAPTIVE_OUTPUT the events run at the fixed intervals, so this only checks the
+output window. With ADAPTIVE_OUTPUT the events run every step, and the
+interval to the next output is shortened by up to ADAPTIVE_OUTPUT_FACTOR near
+impact, pinch-off and peaks in the force (decaying over ADAPTIVE_OUTPUT_WINDOW
+from each), and lengthened by up to ADAPTIVE_OUTPUT_RELAX away from them. An
+output is also made straight away when an event happens, so a long interval
+cannot skip over it. Away from these events the interval is also at least the
+remaining time over the remaining outputs, so the ADAPTIVE_OUTPUT_BUDGET 
+outputs of each kind last until the end of the run */
+bool output_due(output_schedule * schedule) {
+    if ((t < START_OUTPUT_TIME) || (t > END_OUTPUT_TIME)) return false;
+    #if ADAPTIVE_OUTPUT
+    // Pinch-off and force peaks are only known once they have happened
+    double event_times[3] = {IMPACT_TIME, \
+        pinch_off_time > 0. ? pinch_off_time : -HUGE, force_peak_time};
+    bool new_event = false;
+    for (int k = 0; k < 3; k++) {
+        if ((event_times[k] > schedule->last_time) && (event_times[k] <= t)) {
+            new_event = true;
+        }
+    }
+    if (((t < schedule->next_time) && !new_event) \
+            || (schedule->count >= ADAPTIVE_OUTPUT_BUDGET)) {
+        return false;
+    }
+
+    // Closeness to the events, from 0 far away to 1 at an event
+    double weight = 0.;
+    for (int k = 0; k < 3; k++) {
+        weight = max(weight, \
+            exp(-fabs(t - event_times[k]) / ADAPTIVE_OUTPUT_WINDOW));
+    }
+    double tight_interval = schedule->interval / ADAPTIVE_OUTPUT_FACTOR;
+    double relaxed_interval = schedule->interval * ADAPTIVE_OUTPUT_RELAX;
+    double interval \
+        = relaxed_interval + (tight_interval - relaxed_interval) * weight;
+
+    // Spreads the remaining budget over the rest of the run
+    schedule->count++;
+    int remaining = ADAPTIVE_OUTPUT_BUDGET - schedule->count;
+    double end_time = min(END_OUTPUT_TIME, MAX_TIME);
+    double budget_interval \
+        = remaining > 0 ? (end_time - t) / remaining : HUGE;
+    schedule->next_time = t + max(interval, budget_interval * (1. - weight));
+    schedule->last_time = t;
+    #else
+    schedule->count++;
+    #endif
+    return true;
+}
+
+
+/* Centre of the region of interest window for ROI_TRACK, found from the
+current fields. The turnover point is taken as the peak of the pressure on the
+plate, and the tip of the jet as the furthest wetted cell along the plate, 
+with the window resting on the plate for both. The entrapped bubble uses the
+centroid found by the droplet removal event. Returns false if the region does
+not exist at this time */
+bool roi_centre(double * xc, double * yc) {
+    if (ROI_TRACK == 3) {
+        if ((pinch_off_time == 0.) || (bubble_area <= 0.)) return false;
+        *xc = bubble_centroid_x;
+        *yc = bubble_centroid_y;
+        return true;
+    }
+    if (t < IMPACT_TIME) return false;
+
+    double p_peak = -HUGE, y_peak = 0.;
+    double y_wetted = -HUGE;
+    foreach_boundary(left, serial) {
+        if (p[] > p_peak) {
+            p_peak = p[];
+            y_peak = y;
+        }
+        if ((f[] > 0.5) && (y > y_wetted)) {
+            y_wetted = y;
+        }
+    }
+    *xc = X0 + ROI_HALF_WIDTH;
+    if (ROI_TRACK == 1) {
+        *yc = y_peak;
+    } else {
+        if (y_wetted == -HUGE) return false;
+        *yc = y_wetted;
+    }
+    return true;
+}
+
+
+/* Opens an output file of the run. With ARCHIVE_OUTPUT the file is kept in
+memory and added to the run archive run.rca when it is closed, or when the
+archive is synced for files kept open for the whole run */
+FILE * output_open(const char * name, const char * mode) {
+    if (ARCHIVE_OUTPUT) {
+        FILE * fp = archive_fopen(&archive, name, mode);
+        if (fp != NULL) return fp;
+    }
+    return fopen(name, mode);
+}
+
+
+void output_close(FILE * fp) {
+    if (ARCHIVE_OUTPUT) {
+        archive_fclose(&archive, fp, t);
+    } else {
+        fclose(fp);
+    }
+}
+
+
+/* Seeds TRACER_NO tracers on a uniform grid over the rectangle [xmin, xmax] x
+[ymin, ymax], keeping only those in the liquid if liquid is true and in the
+air otherwise */
+void tracers_seed(double xmin, double xmax, double ymin, double ymax, \
+        bool liquid) {
+    if ((xmax <= xmin) || (ymax <= ymin)) return;
+    double spacing = sqrt((xmax - xmin) * (ymax - ymin) / TRACER_NO);
+    int nx = max(1, (int) round((xmax - xmin) / spacing));
+    int ny = max(1, (int) round((ymax - ymin) / spacing));
+    for (int i = 0; i < nx; i++) {
+        for (int j = 0; j < ny; j++) {
+            double xp = xmin + (i + 0.5) * (xmax - xmin) / nx;
+            double yp = ymin + (j + 0.5) * (ymax - ymin) / ny;
+            double fp = interpolate(f, xp, yp);
+            if ((fp == nodata) || ((fp > 0.5) != liquid)) continue;
+            tracer_add(&tracers, xp, yp, \
+                tracer_key(xp, yp, X0, Y0, L0, MAXLEVEL));
+        }
+    }
+    tracer_sort_all(&tracers);
+}
+
+
+/* Bilinear interpolation of s to (xp, yp) from the stencil of the cell at 
+point, as in interpolate(), but without locating the cell again */
+double tracer_velocity(Point point, scalar s, double xp, double yp) {
+    double xi = (xp - x) / Delta, eta = (yp - y) / Delta;
+    int i = sign(xi), j = sign(eta);
+    xi = fabs(xi);
+    eta = fabs(eta);
+    return (s[] * (1. - xi) + s[i] * xi) * (1. - eta) \
+        + (s[0, j] * (1. - xi) + s[i, j] * xi) * eta;
+}
+
+
+/* Functions given to the analysis plugins, see plugin_api.h */
+double plugin_field_value(const char * field, double x, double y) {
+    scalar s = lookup_field(field);
+    if (s.i < 0) return NAN;
+    double value = interpolate(s, x, y);
+    return value == nodata ? NAN : value;
+}
+
+
+long plugin_leaf_cells(const char ** fields, int field_no, double * values, \
+        long max_cells) {
+    scalar * list = NULL;
+    for (int j = 0; j < field_no; j++) {
+        scalar s = lookup_field(fields[j]);
+        if (s.i < 0) {
+            free(list);
+            return -1;
+        }
+        list = list_append(list, s);
+    }
+
+    long k = 0;
+    foreach_cell() {
+        if (is_leaf(cell)) {
+            if (k < max_cells) {
+                double * row = &values[k * (field_no + 3)];
+                row[0] = x;
+                row[1] = y;
+                row[2] = Delta;
+                int j = 3;
+                for (scalar s in list) {
+                    row[j++] = s[];
+                }
+            }
+            k++;
+            continue;
+        }
+    }
+    free(list);
+    return k;
+}
+
+
+void plugin_print(const char * plugin, const char * format, ...) {
+    if (fp_plugins == NULL) {
+        fp_plugins = output_open("plugin_output.txt", "w");
+    }
+    fprintf(fp_plugins, "%s: t = %g, ", plugin, t);
+    va_list args;
+    va_start(args, format);
+    vfprintf(fp_plugins, format, args);
+    va_end(args);
+    fprintf(fp_plugins, "\n");
+}
+
+
+/* Loads the analysis plugins listed in filename, with one line per plugin 
+giving the path to the shared object and an optional argument string. Returns
+-1 if a plugin could not be loaded, and 0 otherwise (including when there is 
+no such file) */
+int plugins_load(const char * filename) {
+    FILE * fp = fopen(filename, "r");
+    if (fp == NULL) return 0;
+
+    char line[1024];
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        char path[1024] = "";
+        int args_start = 0;
+        if (line[0] == '#' || sscanf(line, "%1023s %n", path, &args_start) < 1) {
+            continue;
+        }
+        line[strcspn(line, "\n")] = '\0';
+
+        void * object = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+        const plugin_definition * plugin \
+            = object != NULL ? dlsym(object, "plugin") : NULL;
+        if (plugin == NULL || plugin->api_version != PLUGIN_API_VERSION \
+                || plugin_no == MAX_PLUGINS) {
+            fprintf(stderr, "Error: could not load plugin %s (%s)\n", path, \
+                object == NULL ? dlerror() : "no compatible plugin definition");
+            fclose(fp);
+            return -1;
+        }
+        plugins[plugin_no] = plugin;
+        snprintf(plugin_args[plugin_no], sizeof(plugin_args[0]), "%s", \
+            &line[args_start]);
+        plugin_enabled[plugin_no] = true;
+        fprintf(stderr, "Loaded plugin %s from %s\n", plugin->name, path);
+        plugin_no++;
+    }
+    fclose(fp);
+    return 0;
+}
+
+
+/* Calls the given hook of every enabled plugin */
+void plugins_call(int hook) {
+    if (plugin_no == 0) return;
+
+    plugin_host host = {plugin_field_value, plugin_leaf_cells, plugin_print, \
+        output_open, output_close};
+    plugin_state state = {t, dt, i, grid->n, IMPACT_TIME, current_force, \
+        force_term, s_current, ds_dt, d2s_dt2};
+
+    for (int k = 0; k < plugin_no; k++) {
+        const plugin_definition * plugin = plugins[k];
+        if (!plugin_enabled[k]) continue;
+        if ((hook == PLUGIN_INIT) && (plugin->init != NULL)) {
+            if (plugin->init(&host, &state, plugin_args[k]) != 0) {
+                fprintf(stderr, "Plugin %s failed to initialise, disabling\n", \
+                    plugin->name);
+                plugin_enabled[k] = false;
+            }
+        } else if ((hook == PLUGIN_STEP) && (plugin->step != NULL)) {
+            plugin->step(&host, &state);
+        } else if ((hook == PLUGIN_PLATE_FORCE) \
+                && (plugin->plate_force != NULL)) {
+            plugin->plate_force(&host, &state);
+        } else if ((hook == PLUGIN_END) && (plugin->end != NULL)) {
+            plugin->end(&host, &state);
+        }
+    }
+}
+
+
+/* Diagnostic sampling. Returns true on the first solver step at or after the
+time next_time, which is then moved on by interval. This keeps the cadence of
+a diagnostic without Basilisk shortening the timestep to land on its times */
+bool sample_due(double * next_time, double interval) {
+    if (t < *next_time) return false;
+    while (*next_time <= t) {
+        *next_time += interval;
+    }
+    return true;
+}
+
+
+/* Alternative remove_droplets definition. Rather than allocating its own tag
+field for every call, the tag field d is passed in by the caller */
+void remove_droplets_region(struct RemoveDroplets p, scalar d, \
         double ignore_region_x_limit, double ignore_region_y_limit) {
-    scalar d[], f = p.f;
+    scalar f = p.f;
     double threshold = p.threshold ? p.threshold : 1e-4;
     foreach()
     d[] = (p.bubbles ? 1. - f[] : f[]) > threshold;
@@ -740,3 +1926,183 @@ void remove_droplets_region(struct RemoveDroplets p,\
     }
     boundary ({f});
 }
+
+
+/* Memory usage of the fields. Every cell of the tree (leaf or not) stores a
+Cell header and a block of datasize bytes holding one double for each field
+component, so all components take the same memory and the fields are reported
+by kind. The slots of transient fields (such as the tag field in 
+small_droplet_removal) are never released, as datasize does not shrink, so 
+they count towards the memory even between events. Counting the whole tree
+costs a traversal, so this is only called with MEMORY_STATS */
+void memory_report(FILE * fp) {
+    // Total number of cells in the tree, including the non-leaf cells
+    long total_cells = 0;
+    foreach_cell() {
+        total_cells++;
+    }
+
+    // Peak resident memory of the process
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+
+    // Components of the scalar, vector and face vector fields in use
+    int scalar_no = 0, vector_no = 0, face_no = 0;
+    for (scalar s in all) {
+        if (s.face) {
+            face_no++;
+        } else if (s.v.x.i >= 0) {
+            vector_no++;
+        } else {
+            scalar_no++;
+        }
+    }
+    int slot_no = datasize / sizeof(double);
+    int free_no = slot_no - scalar_no - vector_no - face_no;
+    double component_mb = total_cells * sizeof(double) / 1048576.;
+
+    fprintf(fp, "t: %g #Cells: %ld Cell memory (MB): %g Scalars (MB): %g Vector components (MB): %g Face components (MB): %g Transient slots (MB): %g Peak RSS (MB): %g\n", \
+        t, total_cells, total_cells * (sizeof(Cell) + datasize) / 1048576., \
+        scalar_no * component_mb, vector_no * component_mb, \
+        face_no * component_mb, free_no * component_mb, \
+        usage.ru_maxrss / 1024.);
+    fflush(fp);
+}
+
+
+/* Writes the live metrics in the Prometheus text format. Every metric is 
+labelled with the directory of the run, so the metrics of many runs can be
+collected together */
+void metrics_write(FILE * fp) {
+    char run[1024];
+    if (getcwd(run, sizeof(run)) == NULL) strcpy(run, "unknown");
+
+    // Number of leaf cells on each level
+    long level_cells[MAXLEVEL + 1];
+    for (int l = 0; l <= MAXLEVEL; l++) level_cells[l] = 0;
+    foreach_cell() {
+        if (is_leaf(cell)) {
+            level_cells[level]++;
+            continue;
+        }
+    }
+
+    // Current resident memory, from the number of resident pages
+    long rss_pages = 0;
+    FILE * statm = fopen("/proc/self/statm", "r");
+    if (statm != NULL) {
+        if (fscanf(statm, "%*ld %ld", &rss_pages) != 1) rss_pages = 0;
+        fclose(statm);
+    }
+
+    #define METRIC(name, help, value) \
+        fprintf(fp, "# HELP droplet_%s %s\n# TYPE droplet_%s gauge\n" \
+            "droplet_%s{run=\"%s\"} %g\n", name, help, name, name, run, \
+            (double) (value))
+    METRIC("time", "Simulation time", t);
+    METRIC("step", "Number of steps", i);
+    METRIC("step_rate", "Steps per wall second", metrics_step_rate);
+    METRIC("dt", "Timestep", dt);
+    METRIC("cells", "Number of leaf cells", grid->n);
+    METRIC("rss_bytes", "Resident memory", \
+        rss_pages * (double) sysconf(_SC_PAGESIZE));
+    METRIC("force", "Force on the plate", current_force);
+    METRIC("force_term", "Force term of the plate ODE", force_term);
+    METRIC("s", "Plate position", s_current);
+    METRIC("ds_dt", "Plate velocity", ds_dt);
+    METRIC("mgp_iterations", "Pressure projection iterations", mgp.i);
+    METRIC("mgu_iterations", "Viscous solver iterations", mgu.i);
+    METRIC("eta_seconds", "Estimated wall time to finish", metrics_eta);
+    #undef METRIC
+
+    fprintf(fp, "# HELP droplet_level_cells Number of leaf cells per level\n");
+    fprintf(fp, "# TYPE droplet_level_cells gauge\n");
+    for (int l = 0; l <= MAXLEVEL; l++) {
+        fprintf(fp, "droplet_level_cells{run=\"%s\",level=\"%d\"} %ld\n", \
+            run, l, level_cells[l]);
+    }
+}
+
+
+/* Opens a non-blocking listening socket on the local port, so requests can be
+answered between steps without stalling the solver */
+void metrics_listen(int port) {
+    metrics_socket = socket(AF_INET, SOCK_STREAM, 0);
+    if (metrics_socket < 0) return;
+
+    int reuse = 1;
+    setsockopt(metrics_socket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(port);
+
+    if ((bind(metrics_socket, (struct sockaddr *) &address, \
+            sizeof(address)) < 0) || (listen(metrics_socket, 8) < 0)) {
+        fprintf(stderr, "WARNING: Could not serve metrics on port %d\n", port);
+        close(metrics_socket);
+        metrics_socket = -1;
+        return;
+    }
+    fcntl(metrics_socket, F_SETFL, O_NONBLOCK);
+}
+
+
+/* Answers the requests to the metrics endpoint with the current metrics,
+whatever the request path. The sockets are non-blocking and each connection is
+polled once per step, so a slow client never holds up the solver: connections
+whose request has not arrived yet are kept and polled again on the next step,
+and are dropped if nothing arrives within 5 wall seconds */
+void metrics_serve() {
+    // Accepts the new connections
+    int client;
+    while ((metrics_client_no < METRICS_MAX_CLIENTS) \
+            && ((client = accept(metrics_socket, NULL, NULL)) >= 0)) {
+        fcntl(client, F_SETFL, O_NONBLOCK);
+        metrics_clients[metrics_client_no] = client;
+        metrics_client_times[metrics_client_no] = omp_get_wtime();
+        metrics_client_no++;
+    }
+
+    int k = 0;
+    while (k < metrics_client_no) {
+        client = metrics_clients[k];
+
+        // Reads (and ignores) the request if it has arrived
+        char request[1024];
+        ssize_t received = recv(client, request, sizeof(request), 0);
+        if ((received < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK)) \
+                && (omp_get_wtime() - metrics_client_times[k] < 5.)) {
+            k++;
+            continue;
+        }
+
+        if (received > 0) {
+            char * body = NULL;
+            size_t body_size = 0;
+            FILE * fp = open_memstream(&body, &body_size);
+            metrics_write(fp);
+            fclose(fp);
+
+            char header[128];
+            int header_size = snprintf(header, sizeof(header), \
+                "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+                "Content-Length: %zu\r\n\r\n", body_size);
+            // MSG_NOSIGNAL stops a closed connection from killing the run. The
+            // response fits in the socket buffer, so these do not block
+            if (send(client, header, header_size, MSG_NOSIGNAL) == header_size) {
+                if (send(client, body, body_size, MSG_NOSIGNAL) < 0) {
+                    fprintf(stderr, "WARNING: Could not send metrics\n");
+                }
+            }
+            free(body);
+        }
+
+        // Answered, closed by the client or timed out
+        close(client);
+        metrics_client_no--;
+        metrics_clients[k] = metrics_clients[metrics_client_no];
+        metrics_client_times[k] = metrics_client_times[metrics_client_no];
+    }
+}
@@ -0,0 +1,317 @@
+/* field_codec.h
+    Error-bounded lossy codec for snapshots of the fields on the quadtree,
+    written by droplet_impact_plate.c with COMPRESSED_OUTPUT and decoded by the
+    reader library in data_analysis/reader. Plain C, so it is included by both.
+
+    A snapshot stores the leaf cells in the depth-first order of foreach_cell,
+    where the children of a cell are visited in the order (left, bottom),
+    (left, top), (right, bottom), (right, top). The tree is given by the level
+    of each leaf in this order, so the positions of the cells are recovered by
+    replaying the traversal and are not stored. Consecutive leaves are
+    neighbours in space, so each value is predicted by the previous decoded
+    value of its field and only the residual is stored, quantised to a step
+    of twice the error bound of the field. The prediction uses the decoded
+    value rather than the exact one, so errors do not accumulate and every
+    value is within its error bound. Quantised residuals are written as
+    variable-length integers with runs of zeros collapsed, which removes the
+    uniform regions away from the interface (f = 0 or 1, u = 0) almost entirely.
+
+    File layout (native byte order):
+        "FCDC", int version, int field_no, double t, X0, Y0, L0,
+        long leaf_no, then per field char name[16], double error_bound,
+        then the levels and each field in turn as a long size followed by
+        size bytes
+*/
+
+#ifndef FIELD_CODEC_H
+#define FIELD_CODEC_H
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CODEC_VERSION 1
+#define CODEC_MAX_FIELDS 8
+#define CODEC_NAME_LENGTH 16
+
+/* Tokens of the value streams. Other tokens are a quantised residual q,
+stored as the zigzag encoding of q plus one */
+#define CODEC_ZERO_RUN 0 // Followed by the number of zero residuals
+#define CODEC_ESCAPE 1 // Followed by the exact value as 8 bytes
+
+/* Everything in a snapshot apart from the encoded data */
+typedef struct {
+    double t; // Time of the snapshot
+    double X0, Y0, L0; // Origin and size of the domain
+    int field_no; // Number of fields
+    long leaf_no; // Number of leaf cells
+    char names[CODEC_MAX_FIELDS][CODEC_NAME_LENGTH]; // Names of the fields
+    double error_bounds[CODEC_MAX_FIELDS]; // Absolute error bound of each field
+} codec_header;
+
+/* Growable byte buffer */
+typedef struct {
+    unsigned char * data;
+    size_t size, capacity;
+} codec_buffer;
+
+void codec_put_bytes(codec_buffer * b, const void * bytes, size_t n) {
+    if (b->size + n > b->capacity) {
+        b->capacity = 2 * (b->size + n) + 1024;
+        b->data = realloc(b->data, b->capacity);
+    }
+    memcpy(b->data + b->size, bytes, n);
+    b->size += n;
+}
+
+/* Unsigned integer in 7-bit groups, with the top bit set on all but the
+last byte */
+void codec_put_varint(codec_buffer * b, uint64_t value) {
+    unsigned char bytes[10];
+    int n = 0;
+    while (value >= 128) {
+        bytes[n++] = (unsigned char) (value | 128);
+        value >>= 7;
+    }
+    bytes[n++] = (unsigned char) value;
+    codec_put_bytes(b, bytes, n);
+}
+
+/* Reads a variable-length integer at *p, which is moved past it. Returns -1
+if the data ends first */
+int codec_get_varint(const unsigned char ** p, const unsigned char * end, \
+        uint64_t * value) {
+    *value = 0;
+    for (int shift = 0; shift < 64 && *p < end; shift += 7) {
+        unsigned char byte = *(*p)++;
+        *value |= (uint64_t) (byte & 127) << shift;
+        if (byte < 128) return 0;
+    }
+    return -1;
+}
+
+/* Levels of the leaves, as runs of equal levels */
+void codec_encode_levels(const unsigned char * levels, long n, \
+        codec_buffer * b) {
+    long k = 0;
+    while (k < n) {
+        long run = 1;
+        while (k + run < n && levels[k + run] == levels[k]) run++;
+        codec_put_bytes(b, &levels[k], 1);
+        codec_put_varint(b, run - 1);
+        k += run;
+    }
+}
+
+int codec_decode_levels(const unsigned char * p, const unsigned char * end, \
+        unsigned char * levels, long n) {
+    long k = 0;
+    while (k < n) {
+        if (p >= end) return -1;
+        unsigned char level = *p++;
+        uint64_t run;
+        if (codec_get_varint(&p, end, &run) < 0 || run >= (uint64_t) (n - k)) {
+            return -1;
+        }
+        for (uint64_t j = 0; j <= run; j++) levels[k++] = level;
+    }
+    return 0;
+}
+
+/* Values of one field with the absolute error bound error_bound. A bound of
+zero stores the values exactly */
+void codec_encode_values(const double * values, long n, double error_bound, \
+        codec_buffer * b) {
+    double step = 2. * error_bound;
+    double decoded = 0.; // Previous decoded value, used as the prediction
+    uint64_t zero_run = 0;
+    for (long k = 0; k < n; k++) {
+        double v = values[k];
+        double q = step > 0. ? nearbyint((v - decoded) / step) : 0.;
+        double v_decoded = decoded + q * step;
+
+        // Values which cannot be quantised within the bound are stored exactly
+        if (!(step > 0.) || !isfinite(v) || fabs(q) > 4.5e15 \
+                || !(fabs(v_decoded - v) <= error_bound)) {
+            if (zero_run > 0) {
+                codec_put_varint(b, CODEC_ZERO_RUN);
+                codec_put_varint(b, zero_run);
+                zero_run = 0;
+            }
+            codec_put_varint(b, CODEC_ESCAPE);
+            codec_put_bytes(b, &v, sizeof(double));
+            decoded = isfinite(v) ? v : 0.;
+            continue;
+        }
+
+        if (q == 0.) {
+            zero_run++;
+        } else {
+            if (zero_run > 0) {
+                codec_put_varint(b, CODEC_ZERO_RUN);
+                codec_put_varint(b, zero_run);
+                zero_run = 0;
+            }
+            int64_t qi = (int64_t) q;
+            uint64_t zigzag = ((uint64_t) qi << 1) ^ (uint64_t) (qi >> 63);
+            codec_put_varint(b, zigzag + 1);
+        }
+        decoded = v_decoded;
+    }
+    if (zero_run > 0) {
+        codec_put_varint(b, CODEC_ZERO_RUN);
+        codec_put_varint(b, zero_run);
+    }
+}
+
+/* Decodes n values into values, with a stride between consecutive values so
+they can be written straight into a row of a table */
+int codec_decode_values(const unsigned char * p, const unsigned char * end, \
+        double error_bound, long n, double * values, long stride) {
+    double step = 2. * error_bound;
+    double decoded = 0.;
+    long k = 0;
+    while (k < n) {
+        uint64_t token;
+        if (codec_get_varint(&p, end, &token) < 0) return -1;
+        if (token == CODEC_ZERO_RUN) {
+            uint64_t run;
+            if (codec_get_varint(&p, end, &run) < 0 \
+                    || run > (uint64_t) (n - k)) {
+                return -1;
+            }
+            for (uint64_t j = 0; j < run; j++) values[stride * k++] = decoded;
+        } else if (token == CODEC_ESCAPE) {
+            if (end - p < (long) sizeof(double)) return -1;
+            double v;
+            memcpy(&v, p, sizeof(double));
+            p += sizeof(double);
+            values[stride * k++] = v;
+            decoded = isfinite(v) ? v : 0.;
+        } else {
+            uint64_t zigzag = token - 1;
+            int64_t q = (int64_t) (zigzag >> 1) ^ - (int64_t) (zigzag & 1);
+            decoded = decoded + (double) q * step;
+            values[stride * k++] = decoded;
+        }
+    }
+    return 0;
+}
+
+/* Centres and sizes of the leaves below the cell of the given level with
+bottom left corner (x0, y0), starting from leaf k. Returns the index of the
+next leaf, or -1 if the levels do not describe a tree */
+long codec_place_leaves(const unsigned char * levels, long n, long k, \
+        int level, double x0, double y0, double size, double * xs, \
+        double * ys, double * deltas, long stride) {
+    if (k < 0 || k >= n || levels[k] < level) return -1;
+    if (levels[k] == level) {
+        xs[stride * k] = x0 + size / 2.;
+        ys[stride * k] = y0 + size / 2.;
+        deltas[stride * k] = size;
+        return k + 1;
+    }
+    for (int i = 0; i <= 1; i++) {
+        for (int j = 0; j <= 1; j++) {
+            k = codec_place_leaves(levels, n, k, level + 1, x0 + i * size / 2., \
+                y0 + j * size / 2., size / 2., xs, ys, deltas, stride);
+        }
+    }
+    return k;
+}
+
+/* Writes a snapshot, where values holds the leaf_no values of each field in
+turn. Returns the number of bytes written, or -1 on failure */
+long codec_write(FILE * fp, const codec_header * header, \
+        const unsigned char * levels, const double * values) {
+    codec_buffer b = {NULL, 0, 0};
+    int version = CODEC_VERSION;
+    codec_put_bytes(&b, "FCDC", 4);
+    codec_put_bytes(&b, &version, sizeof(int));
+    codec_put_bytes(&b, &header->field_no, sizeof(int));
+    codec_put_bytes(&b, &header->t, sizeof(double));
+    codec_put_bytes(&b, &header->X0, sizeof(double));
+    codec_put_bytes(&b, &header->Y0, sizeof(double));
+    codec_put_bytes(&b, &header->L0, sizeof(double));
+    codec_put_bytes(&b, &header->leaf_no, sizeof(long));
+    for (int j = 0; j < header->field_no; j++) {
+        codec_put_bytes(&b, header->names[j], CODEC_NAME_LENGTH);
+        codec_put_bytes(&b, &header->error_bounds[j], sizeof(double));
+    }
+
+    // Each section is preceded by its size, which is filled in afterwards
+    for (int j = -1; j < header->field_no; j++) {
+        long size = 0;
+        size_t size_position = b.size;
+        codec_put_bytes(&b, &size, sizeof(long));
+        if (j < 0) {
+            codec_encode_levels(levels, header->leaf_no, &b);
+        } else {
+            codec_encode_values(values + j * header->leaf_no, \
+                header->leaf_no, header->error_bounds[j], &b);
+        }
+        size = b.size - size_position - sizeof(long);
+        memcpy(b.data + size_position, &size, sizeof(long));
+    }
+
+    long written = fwrite(b.data, 1, b.size, fp) == b.size ? (long) b.size : -1;
+    free(b.data);
+    return written;
+}
+
+/* Reads the header of the snapshot in [start, end). Returns the position of
+the encoded levels, or NULL if this is not a snapshot */
+const unsigned char * codec_read_header(const unsigned char * start, \
+        const unsigned char * end, codec_header * header) {
+    const unsigned char * p = start;
+    int version;
+    size_t fixed_size = 4 + 2 * sizeof(int) + 4 * sizeof(double) + sizeof(long);
+    if (end - start < (long) fixed_size || memcmp(p, "FCDC", 4)) return NULL;
+    p += 4;
+    memcpy(&version, p, sizeof(int));
+    p += sizeof(int);
+    memcpy(&header->field_no, p, sizeof(int));
+    p += sizeof(int);
+    memcpy(&header->t, p, sizeof(double));
+    p += sizeof(double);
+    memcpy(&header->X0, p, sizeof(double));
+    p += sizeof(double);
+    memcpy(&header->Y0, p, sizeof(double));
+    p += sizeof(double);
+    memcpy(&header->L0, p, sizeof(double));
+    p += sizeof(double);
+    memcpy(&header->leaf_no, p, sizeof(long));
+    p += sizeof(long);
+    if (version != CODEC_VERSION || header->field_no < 0 \
+            || header->field_no > CODEC_MAX_FIELDS || header->leaf_no < 0) {
+        return NULL;
+    }
+    for (int j = 0; j < header->field_no; j++) {
+        if (end - p < CODEC_NAME_LENGTH + (long) sizeof(double)) return NULL;
+        memcpy(header->names[j], p, CODEC_NAME_LENGTH);
+        header->names[j][CODEC_NAME_LENGTH - 1] = '\0';
+        p += CODEC_NAME_LENGTH;
+        memcpy(&header->error_bounds[j], p, sizeof(double));
+        p += sizeof(double);
+    }
+    return p;
+}
+
+/* Position and size of the next section at *p, which is moved past it.
+Returns -1 if the data ends first */
+int codec_section(const unsigned char ** p, const unsigned char * end, \
+        const unsigned char ** section, const unsigned char ** section_end) {
+    long size;
+    if (end - *p < (long) sizeof(long)) return -1;
+    memcpy(&size, *p, sizeof(long));
+    *p += sizeof(long);
+    if (size < 0 || end - *p < size) return -1;
+    *section = *p;
+    *section_end = *p + size;
+    *p += size;
+    return 0;
+}
+
+#endif
@@ -0,0 +1,80 @@
+/* plugin_api.h
+    Interface for analysis plugins, which are shared objects loaded by
+    droplet_impact_plate.c at startup. This lets new diagnostics be switched on
+    per campaign without editing or recompiling the simulation. The plugins are
+    listed in the file PLUGIN_FILE, one per line as the path to the shared
+    object followed by an optional argument string. Lines starting with # are
+    ignored. If the file does not exist no plugins are loaded, and the hooks
+    cost nothing.
+
+    A plugin defines a plugin_definition named "plugin", giving the API version
+    it was built against, its name and the hooks it implements (any of which
+    may be NULL):
+        init: after the initial condition is set, with the argument string.
+            Returning non-zero disables the plugin for the rest of the run
+        step: after every solver step
+        plate_force: each time the force on the plate has been evaluated and
+            the force term of the plate ODE chosen, before the plate is moved
+        end: at the end of the run
+
+    The hooks are given the host, which has read-only access to the fields
+    and the output sink, and the current state of the run. Plugins are plain C
+    and are compiled separately from the simulation, see
+    droplet_impact_plate/plugins for an example.
+*/
+
+#ifndef PLUGIN_API_H
+#define PLUGIN_API_H
+
+#include <stdio.h>
+
+#define PLUGIN_API_VERSION 1
+
+/* State of the run when a hook is called */
+typedef struct {
+    double t; // Simulation time
+    double dt; // Current timestep
+    int i; // Solver step
+    long cells; // Number of leaf cells
+    double impact_time; // Theoretical time of impact
+    double force; // Force on the plate from the last evaluation
+    double force_term; // Force used in the plate ODE (after peak detection)
+    double s, sdot, sddot; // Plate displacement and its derivatives
+} plugin_state;
+
+/* Access to the simulation */
+typedef struct {
+    /* Value of the field with the given name (e.g. "p", "f" or "u.x") at the
+    point (x, y), or NAN if there is no such field or the point is outside
+    the domain */
+    double (*field_value)(const char * field, double x, double y);
+
+    /* Copies the leaf cells into values, as rows of x, y, Delta and then the
+    field_no named fields, for at most max_cells cells. Returns the number of
+    leaf cells (so calling with max_cells = 0 gives the size needed), or -1 if
+    one of the fields does not exist */
+    long (*leaf_cells)(const char ** fields, int field_no, double * values, \
+        long max_cells);
+
+    /* Shared output sink. Writes a line to plugin_output.txt starting with
+    the name of the plugin and the time, followed by the formatted text */
+    void (*print)(const char * plugin, const char * format, ...);
+
+    /* Opens and closes an output file of the plugin, which is written into
+    the run archive with ARCHIVE_OUTPUT */
+    FILE * (*open_output)(const char * name, const char * mode);
+    void (*close_output)(FILE * fp);
+} plugin_host;
+
+/* Definition exported by each plugin under the name "plugin" */
+typedef struct {
+    int api_version; // PLUGIN_API_VERSION the plugin was built against
+    const char * name;
+    int (*init)(const plugin_host * host, const plugin_state * state, \
+        const char * args);
+    void (*step)(const plugin_host * host, const plugin_state * state);
+    void (*plate_force)(const plugin_host * host, const plugin_state * state);
+    void (*end)(const plugin_host * host, const plugin_state * state);
+} plugin_definition;
+
+#endif
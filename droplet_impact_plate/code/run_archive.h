@@ -0,0 +1,330 @@
+/* run_archive.h
+    Single-file container for the outputs of a run, written by
+    droplet_impact_plate.c with ARCHIVE_OUTPUT and read by the tool in
+    data_analysis/archive, which extracts the usual files on demand. Plain C,
+    so it is included by both.
+
+    The archive is a sequence of chunks, each holding data for one of the
+    output files of the run, so a run makes one file on disk rather than
+    thousands. Output files are opened with archive_fopen, which returns an
+    in-memory stream, and their contents are written as a chunk when closed
+    with archive_fclose. Files which are kept open for the whole run (such as
+    logstats.dat) are written as a new chunk each time archive_sync is called.
+    A file is the concatenation of its chunks from its last ARCHIVE_WRITE
+    chunk onwards, so opening a file with "w" replaces its earlier contents
+    and with "a" adds to them, as for fopen.
+
+    Layout (native byte order):
+        chunk: "RCHK", int mode, double t, long size, int name_length, name,
+            then size bytes of data
+        table of contents: "RTOC", int entry_no, then for each chunk
+            int mode, double t, long offset, long size, int name_length, name
+        trailer: "REND", long offset of the table of contents
+
+    The table of contents is written when the archive is closed, so the
+    chunks can be listed without reading the whole archive. If a run is
+    killed there is no table, and the chunks are instead found by scanning
+    from the start, stopping at a chunk that was only partly written.
+    Opening an existing archive for writing removes the table (and any
+    partial chunk) and appends after the last chunk, so restarted runs add to
+    the same archive.
+*/
+
+#ifndef RUN_ARCHIVE_H
+#define RUN_ARCHIVE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define ARCHIVE_NAME_LENGTH 256 // Maximum length of a file name
+#define ARCHIVE_MAX_STREAMS 32 // Maximum number of files open at once
+
+enum { ARCHIVE_WRITE, ARCHIVE_APPEND }; // Modes of a chunk
+
+/* Chunk of one file in the archive */
+typedef struct {
+    char name[ARCHIVE_NAME_LENGTH];
+    int mode; // ARCHIVE_WRITE or ARCHIVE_APPEND
+    double t; // Simulation time the chunk was written
+    long offset; // Position of the data of the chunk in the archive
+    long size; // Size of the data in bytes
+} archive_entry;
+
+/* Output file which is open in memory */
+typedef struct {
+    FILE * fp; // In-memory stream, or NULL if this slot is free
+    char * buffer;
+    size_t size;
+    char name[ARCHIVE_NAME_LENGTH];
+    int mode; // Mode of the next chunk of the file
+} archive_stream;
+
+typedef struct {
+    FILE * fp;
+    int writable;
+    archive_entry * entries;
+    int entry_no, entry_capacity;
+    archive_stream streams[ARCHIVE_MAX_STREAMS];
+} run_archive;
+
+
+/* Reading and writing of the index */
+static int archive_read_name(FILE * fp, char * name) {
+    int length;
+    if (fread(&length, sizeof(int), 1, fp) != 1 || length < 0 \
+            || length >= ARCHIVE_NAME_LENGTH) {
+        return -1;
+    }
+    if (fread(name, 1, length, fp) != (size_t) length) return -1;
+    name[length] = '\0';
+    return 0;
+}
+
+static void archive_write_name(FILE * fp, const char * name) {
+    int length = strlen(name);
+    fwrite(&length, sizeof(int), 1, fp);
+    fwrite(name, 1, length, fp);
+}
+
+static void archive_add_entry(run_archive * a, const archive_entry * entry) {
+    if (a->entry_no == a->entry_capacity) {
+        a->entry_capacity = a->entry_capacity ? 2 * a->entry_capacity : 256;
+        a->entries \
+            = realloc(a->entries, a->entry_capacity * sizeof(archive_entry));
+    }
+    a->entries[a->entry_no++] = *entry;
+}
+
+/* Reads the table of contents. Returns the position it starts at (which is
+the end of the chunks), or -1 if there is none */
+static long archive_read_toc(run_archive * a) {
+    char magic[4];
+    long toc_offset, end;
+    if (fseek(a->fp, 0, SEEK_END) != 0) return -1;
+    end = ftell(a->fp);
+    if (end < 4 + (long) sizeof(long)) return -1;
+    fseek(a->fp, end - 4 - (long) sizeof(long), SEEK_SET);
+    if (fread(magic, 1, 4, a->fp) != 4 || memcmp(magic, "REND", 4) \
+            || fread(&toc_offset, sizeof(long), 1, a->fp) != 1 \
+            || toc_offset < 0 || toc_offset >= end) {
+        return -1;
+    }
+
+    int entry_no;
+    fseek(a->fp, toc_offset, SEEK_SET);
+    if (fread(magic, 1, 4, a->fp) != 4 || memcmp(magic, "RTOC", 4) \
+            || fread(&entry_no, sizeof(int), 1, a->fp) != 1 || entry_no < 0) {
+        return -1;
+    }
+    for (int k = 0; k < entry_no; k++) {
+        archive_entry entry;
+        if (fread(&entry.mode, sizeof(int), 1, a->fp) != 1 \
+                || fread(&entry.t, sizeof(double), 1, a->fp) != 1 \
+                || fread(&entry.offset, sizeof(long), 1, a->fp) != 1 \
+                || fread(&entry.size, sizeof(long), 1, a->fp) != 1 \
+                || archive_read_name(a->fp, entry.name) < 0) {
+            a->entry_no = 0;
+            return -1;
+        }
+        archive_add_entry(a, &entry);
+    }
+    return toc_offset;
+}
+
+/* Finds the chunks by reading their headers from the start of the archive.
+Returns the end of the last complete chunk */
+static long archive_scan(run_archive * a) {
+    long end = 0;
+    a->entry_no = 0;
+    fseek(a->fp, 0, SEEK_SET);
+    for (;;) {
+        char magic[4];
+        archive_entry entry;
+        if (fread(magic, 1, 4, a->fp) != 4 || memcmp(magic, "RCHK", 4) \
+                || fread(&entry.mode, sizeof(int), 1, a->fp) != 1 \
+                || fread(&entry.t, sizeof(double), 1, a->fp) != 1 \
+                || fread(&entry.size, sizeof(long), 1, a->fp) != 1 \
+                || entry.size < 0 \
+                || archive_read_name(a->fp, entry.name) < 0) {
+            return end;
+        }
+        entry.offset = ftell(a->fp);
+        // A chunk which runs past the end of the file was only partly written
+        if (fseek(a->fp, entry.size, SEEK_CUR) != 0) return end;
+        char last;
+        if (entry.size > 0) {
+            fseek(a->fp, -1, SEEK_CUR);
+            if (fread(&last, 1, 1, a->fp) != 1) return end;
+        }
+        archive_add_entry(a, &entry);
+        end = entry.offset + entry.size;
+    }
+}
+
+/* Opens the archive filename. With writable the archive is created if it
+does not exist, and chunks are added after the existing ones. Returns 0 on
+success and -1 on failure */
+int archive_open(run_archive * a, const char * filename, int writable) {
+    memset(a, 0, sizeof(run_archive));
+    a->writable = writable;
+    a->fp = fopen(filename, writable ? "r+b" : "rb");
+    if (a->fp == NULL && writable) a->fp = fopen(filename, "w+b");
+    if (a->fp == NULL) return -1;
+
+    long end = archive_read_toc(a);
+    if (end < 0) end = archive_scan(a);
+    if (writable) {
+        fflush(a->fp);
+        if (ftruncate(fileno(a->fp), end) != 0) return -1;
+        fseek(a->fp, end, SEEK_SET);
+    }
+    return 0;
+}
+
+/* Adds a chunk of data to the file name. Returns 0 on success */
+int archive_add(run_archive * a, const char * name, int mode, double t, \
+        const void * data, long size) {
+    archive_entry entry;
+    snprintf(entry.name, ARCHIVE_NAME_LENGTH, "%s", name);
+    entry.mode = mode;
+    entry.t = t;
+    entry.size = size;
+
+    fwrite("RCHK", 1, 4, a->fp);
+    fwrite(&mode, sizeof(int), 1, a->fp);
+    fwrite(&t, sizeof(double), 1, a->fp);
+    fwrite(&size, sizeof(long), 1, a->fp);
+    archive_write_name(a->fp, entry.name);
+    entry.offset = ftell(a->fp);
+    if (size > 0 && fwrite(data, 1, size, a->fp) != (size_t) size) return -1;
+    archive_add_entry(a, &entry);
+    return 0;
+}
+
+
+/* Output files kept in memory until they are closed or synced */
+
+/* Opens the file name with mode "w" or "a" as an in-memory stream. Returns
+NULL if too many files are open */
+FILE * archive_fopen(run_archive * a, const char * name, const char * mode) {
+    for (int k = 0; k < ARCHIVE_MAX_STREAMS; k++) {
+        archive_stream * s = &a->streams[k];
+        if (s->fp != NULL) continue;
+        s->fp = open_memstream(&s->buffer, &s->size);
+        if (s->fp == NULL) return NULL;
+        snprintf(s->name, ARCHIVE_NAME_LENGTH, "%s", name);
+        s->mode = mode[0] == 'a' ? ARCHIVE_APPEND : ARCHIVE_WRITE;
+        return s->fp;
+    }
+    return NULL;
+}
+
+/* Writes what has been written to the stream since it was last synced as a
+new chunk. The stream is rewound so that its memory does not keep growing */
+static void archive_write_stream(run_archive * a, archive_stream * s, \
+        double t) {
+    fflush(s->fp);
+    if (s->size > 0 || s->mode == ARCHIVE_WRITE) {
+        archive_add(a, s->name, s->mode, t, s->buffer, s->size);
+        s->mode = ARCHIVE_APPEND;
+    }
+    rewind(s->fp);
+}
+
+/* Closes a stream opened by archive_fopen, adding its contents to the
+archive. Streams which were not opened by archive_fopen are closed with
+fclose */
+int archive_fclose(run_archive * a, FILE * fp, double t) {
+    for (int k = 0; k < ARCHIVE_MAX_STREAMS; k++) {
+        archive_stream * s = &a->streams[k];
+        if (s->fp != fp || fp == NULL) continue;
+        archive_write_stream(a, s, t);
+        fclose(s->fp);
+        free(s->buffer);
+        s->fp = NULL;
+        s->buffer = NULL;
+        return 0;
+    }
+    return fclose(fp);
+}
+
+/* Writes the contents of all open streams, so they are not lost if the run
+is killed, and flushes the archive to disk */
+void archive_sync(run_archive * a, double t) {
+    for (int k = 0; k < ARCHIVE_MAX_STREAMS; k++) {
+        if (a->streams[k].fp != NULL) {
+            archive_write_stream(a, &a->streams[k], t);
+        }
+    }
+    fflush(a->fp);
+}
+
+/* Closes the archive. If it was opened for writing, any open streams are
+closed and the table of contents is written */
+void archive_close(run_archive * a, double t) {
+    if (a->writable) {
+        for (int k = 0; k < ARCHIVE_MAX_STREAMS; k++) {
+            if (a->streams[k].fp != NULL) {
+                archive_fclose(a, a->streams[k].fp, t);
+            }
+        }
+        long toc_offset = ftell(a->fp);
+        fwrite("RTOC", 1, 4, a->fp);
+        fwrite(&a->entry_no, sizeof(int), 1, a->fp);
+        for (int k = 0; k < a->entry_no; k++) {
+            archive_entry * entry = &a->entries[k];
+            fwrite(&entry->mode, sizeof(int), 1, a->fp);
+            fwrite(&entry->t, sizeof(double), 1, a->fp);
+            fwrite(&entry->offset, sizeof(long), 1, a->fp);
+            fwrite(&entry->size, sizeof(long), 1, a->fp);
+            archive_write_name(a->fp, entry->name);
+        }
+        fwrite("REND", 1, 4, a->fp);
+        fwrite(&toc_offset, sizeof(long), 1, a->fp);
+    }
+    fclose(a->fp);
+    free(a->entries);
+    a->entries = NULL;
+    a->entry_no = a->entry_capacity = 0;
+}
+
+
+/* Reading of files */
+
+/* Index of the first chunk of the current contents of the file name, i.e. its
+last ARCHIVE_WRITE chunk, or -1 if the file is not in the archive */
+int archive_find(const run_archive * a, const char * name) {
+    int first = -1;
+    for (int k = 0; k < a->entry_no; k++) {
+        if (strcmp(a->entries[k].name, name)) continue;
+        if (first < 0 || a->entries[k].mode == ARCHIVE_WRITE) first = k;
+    }
+    return first;
+}
+
+/* Copies the contents of the file name into out. Returns the number of bytes
+copied, or -1 if the file is not in the archive */
+long archive_extract(run_archive * a, const char * name, FILE * out) {
+    int first = archive_find(a, name);
+    if (first < 0) return -1;
+    long total = 0;
+    char buffer[65536];
+    for (int k = first; k < a->entry_no; k++) {
+        archive_entry * entry = &a->entries[k];
+        if (strcmp(entry->name, name)) continue;
+        fseek(a->fp, entry->offset, SEEK_SET);
+        for (long remaining = entry->size; remaining > 0;) {
+            size_t n = remaining < (long) sizeof(buffer) \
+                ? (size_t) remaining : sizeof(buffer);
+            if (fread(buffer, 1, n, a->fp) != n) return -1;
+            fwrite(buffer, 1, n, out);
+            remaining -= n;
+            total += n;
+        }
+    }
+    return total;
+}
+
+#endif
@@ -0,0 +1,173 @@
+/* tracers.h
+    Lagrangian tracer particles advected by droplet_impact_plate.c, and the
+    trajectory stream tracers.trj they are written to, which is read by the
+    reader library in data_analysis/reader. Plain C, so it is included by both.
+
+    The tracers are kept sorted by the Morton (Z-order) key of their position
+    on a uniform grid at the finest level of the quadtree. Every cell of the
+    quadtree covers a contiguous range of these keys, so the tracers inside a
+    leaf cell are found with a binary search and are next to each other in
+    memory, and each cell moves its own tracers using only its own stencil.
+    Tracers move less than a cell in a step, so the array stays nearly sorted
+    and an insertion sort restores the order in close to linear time. A newly
+    seeded block is in no particular order, so it is sorted with qsort.
+
+    Stream layout (native byte order):
+        "TRAJ", int version, then for each frame double t, int n, followed
+        by n records of unsigned int id, float x, float y
+*/
+
+#ifndef TRACERS_H
+#define TRACERS_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TRACER_VERSION 1
+#define TRACER_OUTSIDE UINT64_MAX // Key of a tracer which has left the domain
+
+typedef struct {
+    double x, y; // Position
+    uint64_t key; // Morton key of the position, see tracer_key
+    unsigned int id; // Identifier, which is kept for the whole run
+} tracer;
+
+/* Growable array of tracers, sorted by key */
+typedef struct {
+    tracer * p;
+    int n, capacity;
+    unsigned int next_id; // Identifier given to the next tracer added
+} tracer_set;
+
+/* Interleaves the bits of the cell indices i and j, so the key of a cell at
+a coarser level, shifted up by twice the difference in levels, is the first
+key of the cells inside it */
+uint64_t tracer_morton(uint32_t i, uint32_t j) {
+    uint64_t key = 0;
+    for (int b = 0; b < 32; b++) {
+        key |= (uint64_t) ((i >> b) & 1) << (2 * b + 1);
+        key |= (uint64_t) ((j >> b) & 1) << (2 * b);
+    }
+    return key;
+}
+
+/* Key of the cell of the given level containing (x, y), in the square domain
+with bottom left corner (X0, Y0) and size L0 */
+uint64_t tracer_key(double x, double y, double X0, double Y0, double L0, \
+        int level) {
+    double cells = (double) ((uint64_t) 1 << level);
+    double i = (x - X0) / L0 * cells, j = (y - Y0) / L0 * cells;
+    if (!(i >= 0. && i < cells && j >= 0. && j < cells)) return TRACER_OUTSIDE;
+    return tracer_morton((uint32_t) i, (uint32_t) j);
+}
+
+void tracer_add(tracer_set * s, double x, double y, uint64_t key) {
+    if (s->n == s->capacity) {
+        s->capacity = 2 * s->capacity + 256;
+        s->p = realloc(s->p, s->capacity * sizeof(tracer));
+    }
+    tracer tr = {x, y, key, s->next_id++};
+    s->p[s->n++] = tr;
+}
+
+/* Drops the tracers which have left the domain, which sort to the end */
+void tracer_drop_outside(tracer_set * s) {
+    while (s->n > 0 && s->p[s->n - 1].key == TRACER_OUTSIDE) s->n--;
+}
+
+/* Sorts the tracers by key with an insertion sort, which is fast as the
+order changes little between steps, then drops those outside the domain */
+void tracer_sort(tracer_set * s) {
+    for (int k = 1; k < s->n; k++) {
+        tracer tr = s->p[k];
+        int m = k - 1;
+        while (m >= 0 && s->p[m].key > tr.key) {
+            s->p[m + 1] = s->p[m];
+            m--;
+        }
+        s->p[m + 1] = tr;
+    }
+    tracer_drop_outside(s);
+}
+
+int tracer_compare(const void * a, const void * b) {
+    uint64_t key_a = ((const tracer *) a)->key;
+    uint64_t key_b = ((const tracer *) b)->key;
+    return (key_a > key_b) - (key_a < key_b);
+}
+
+/* Sorts the tracers by key with qsort, for after a block of tracers has been
+added, then drops those outside the domain */
+void tracer_sort_all(tracer_set * s) {
+    qsort(s->p, s->n, sizeof(tracer), tracer_compare);
+    tracer_drop_outside(s);
+}
+
+/* Index of the first tracer with a key of at least key */
+int tracer_find(const tracer_set * s, uint64_t key) {
+    int low = 0, high = s->n;
+    while (low < high) {
+        int middle = low + (high - low) / 2;
+        if (s->p[middle].key < key) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+void tracer_write_header(FILE * fp) {
+    int version = TRACER_VERSION;
+    fwrite("TRAJ", 1, 4, fp);
+    fwrite(&version, sizeof(int), 1, fp);
+}
+
+/* Writes the positions of all of the tracers at time t as one frame, with
+the positions in single precision */
+void tracer_write_frame(FILE * fp, const tracer_set * s, double t) {
+    size_t record_size = sizeof(unsigned int) + 2 * sizeof(float);
+    unsigned char * frame = malloc(s->n * record_size + 1);
+    for (int k = 0; k < s->n; k++) {
+        float position[2] = {(float) s->p[k].x, (float) s->p[k].y};
+        memcpy(frame + k * record_size, &s->p[k].id, sizeof(unsigned int));
+        memcpy(frame + k * record_size + sizeof(unsigned int), position, \
+            2 * sizeof(float));
+    }
+    fwrite(&t, sizeof(double), 1, fp);
+    fwrite(&s->n, sizeof(int), 1, fp);
+    fwrite(frame, record_size, s->n, fp);
+    free(frame);
+}
+
+/* Checks the header of the stream in [start, end). Returns the position of
+the first frame, or NULL if this is not a trajectory stream */
+const unsigned char * tracer_read_header(const unsigned char * start, \
+        const unsigned char * end) {
+    int version;
+    if (end - start < 4 + (long) sizeof(int) || memcmp(start, "TRAJ", 4)) {
+        return NULL;
+    }
+    memcpy(&version, start + 4, sizeof(int));
+    return version == TRACER_VERSION ? start + 4 + sizeof(int) : NULL;
+}
+
+/* Reads the frame at *p, which is moved past it, setting the time and number
+of tracers and pointing records at the n records. Returns -1 if the stream
+ends first, which happens for the last frame of a run that was stopped */
+int tracer_read_frame(const unsigned char ** p, const unsigned char * end, \
+        double * t, int * n, const unsigned char ** records) {
+    size_t record_size = sizeof(unsigned int) + 2 * sizeof(float);
+    if (end - *p < (long) (sizeof(double) + sizeof(int))) return -1;
+    memcpy(t, *p, sizeof(double));
+    memcpy(n, *p + sizeof(double), sizeof(int));
+    const unsigned char * start = *p + sizeof(double) + sizeof(int);
+    if (*n < 0 || (size_t) (end - start) < *n * record_size) return -1;
+    *records = start;
+    *p = start + *n * record_size;
+    return 0;
+}
+
+#endif
@@ -0,0 +1,187 @@
+/* wagner.h
+    Wagner theory reference models for the impact of an axisymmetric droplet
+    onto a plate, ported from the MATLAB scripts in deprecated_data_analysis
+    (s_dependents.m, the forces directory, wagner_pressure.m and
+    s_solution.m). Plain C, so it is included both by droplet_impact_plate.c
+    and by the batch tools in data_analysis/wagner.
+
+    All functions take the time since impact t, the plate displacement s and
+    its derivatives sdot and sddot (positive away from the droplet) and the
+    small parameter eps, where eps = 1 gives the scaling of the simulations.
+    Before the turnover point exists (t <= s) the forces and pressures are
+    zero.
+*/
+
+#ifndef WAGNER_H
+#define WAGNER_H
+
+#include <math.h>
+#include <stddef.h>
+
+/* Turnover point d, its derivatives and the jet thickness J */
+typedef struct {
+    double d, ddot, dddot, J;
+} wagner_dependents;
+
+wagner_dependents wagner_s_dependents(double t, double s, double sdot, \
+        double sddot) {
+    wagner_dependents w = {0., 0., 0., 0.};
+    double tau = t - s;
+    if (tau <= 0.) return w;
+    w.d = sqrt(3. * tau);
+    w.ddot = (sqrt(3.) / 2.) * (1. - sdot) / sqrt(tau);
+    w.dddot = - (sqrt(3.) / 4.) * ((1. - sdot) * (1. - sdot) \
+        + 2. * tau * sddot) / pow(tau, 1.5);
+    w.J = 2. * pow(tau, 1.5) / (sqrt(3.) * M_PI);
+    return w;
+}
+
+/* Solves sigma + 4 sqrt(sigma) + log(sigma) = c for sigma, using Newton's
+method on sqrt(sigma), which replaces fsolve in the MATLAB scripts */
+double wagner_sigma(double c) {
+    double x = c > 1. ? sqrt(c) : exp(c / 2.); // Guess for sqrt(sigma)
+    for (int k = 0; k < 50; k++) {
+        double residual = x * x + 4. * x + 2. * log(x) - c;
+        double step = residual / (2. * x + 4. + 2. / x);
+        // Stops sqrt(sigma) from becoming negative
+        x = step < x ? x - step : x / 2.;
+        if (fabs(step) < 1e-14 * x) break;
+    }
+    return x * x;
+}
+
+/* Force from the outer region */
+double wagner_outer_force(double t, double s, double sdot, double sddot, \
+        double eps) {
+    wagner_dependents w = wagner_s_dependents(t, s, sdot, sddot);
+    return (8. * eps / 9.) * w.d * w.d * w.d \
+        * (4. * w.ddot * w.ddot + w.dddot * w.d);
+}
+
+/* Force from the inner region, where eta_0 = log(sigma_0) / 2 is the upper
+limit of the integral over the inner region */
+double wagner_inner_force(double t, double s, double sdot, double sddot, \
+        double eps) {
+    wagner_dependents w = wagner_s_dependents(t, s, sdot, sddot);
+    if (w.J <= 0.) return 0.;
+    double c = M_PI * w.d / (eps * eps * w.J);
+    double sigma_0 = wagner_sigma(c);
+    double eta_0 = 0.5 * log(sigma_0);
+    return (8. * pow(eps, 4) / M_PI) * w.ddot * w.ddot * w.J * w.J \
+        * exp(eta_0) * (c + 1. - sigma_0 / 3. - 2. * exp(eta_0) - 2. * eta_0);
+}
+
+/* Force from the overlap region */
+double wagner_overlap_force(double t, double s, double sdot, double sddot, \
+        double eps) {
+    wagner_dependents w = wagner_s_dependents(t, s, sdot, sddot);
+    return (16. * sqrt(2.) * eps / 9.) * w.d * w.d * w.d * w.ddot * w.ddot;
+}
+
+/* Composite force, given by the outer plus inner minus overlap forces */
+double wagner_composite_force(double t, double s, double sdot, double sddot, \
+        double eps) {
+    return wagner_outer_force(t, s, sdot, sddot, eps) \
+        + wagner_inner_force(t, s, sdot, sddot, eps) \
+        - wagner_overlap_force(t, s, sdot, sddot, eps);
+}
+
+/* Pressure of the outer solution at the radial position r */
+double wagner_outer_pressure(double r, double t, double s, double sdot, \
+        double sddot, double eps) {
+    wagner_dependents w = wagner_s_dependents(t, s, sdot, sddot);
+    double rhat = r / eps;
+    if (rhat >= w.d) return 0.;
+    double root = sqrt(w.d * w.d - rhat * rhat);
+    return (1. / eps) * (4. * (2. * w.d * w.d - rhat * rhat) * w.ddot * w.ddot \
+        / (3. * M_PI * root) + 4. * w.d * w.dddot * root / (3. * M_PI));
+}
+
+/* Radial position of the point sigma in the inner region */
+double wagner_inner_radius(double sigma, double t, double s, double sdot, \
+        double sddot, double eps) {
+    wagner_dependents w = wagner_s_dependents(t, s, sdot, sddot);
+    double tilde_r \
+        = - (w.J / M_PI) * (sigma + 4. * sqrt(sigma) + log(sigma) + 1.);
+    return eps * w.d + eps * eps * eps * tilde_r;
+}
+
+/* Pressure of the inner solution at the point sigma */
+double wagner_inner_pressure(double sigma, double t, double s, double sdot, \
+        double sddot, double eps) {
+    wagner_dependents w = wagner_s_dependents(t, s, sdot, sddot);
+    return (2. / (eps * eps)) * w.ddot * w.ddot * sqrt(sigma) \
+        / ((1. + sqrt(sigma)) * (1. + sqrt(sigma)));
+}
+
+/* Pressure of the overlap solution at the radial position r */
+double wagner_overlap_pressure(double r, double t, double s, double sdot, \
+        double sddot, double eps) {
+    wagner_dependents w = wagner_s_dependents(t, s, sdot, sddot);
+    double distance = w.d / (eps * eps) - r / (eps * eps * eps);
+    if (distance <= 0.) return 0.;
+    return 2. * sqrt(2.) * pow(w.d, 1.5) * w.ddot * w.ddot \
+        / (3. * M_PI * eps * eps * sqrt(distance));
+}
+
+/* Composite pressure at the radial position r, where the point sigma of the
+inner region is found by inverting wagner_inner_radius */
+double wagner_composite_pressure(double r, double t, double s, double sdot, \
+        double sddot, double eps) {
+    wagner_dependents w = wagner_s_dependents(t, s, sdot, sddot);
+    if (w.J <= 0. || r < 0.) return 0.;
+    double c = - M_PI * (r - eps * w.d) / (eps * eps * eps * w.J) - 1.;
+    double sigma = wagner_sigma(c);
+    double p = wagner_inner_pressure(sigma, t, s, sdot, sddot, eps) \
+        + wagner_outer_pressure(r, t, s, sdot, sddot, eps) \
+        - wagner_overlap_pressure(r, t, s, sdot, sddot, eps);
+    return p > 0. ? p : 0.;
+}
+
+/* Maximum pressure, which is the peak of the inner solution at sigma = 1.
+For a stationary plate with eps = 1 this is 3 / (8 t) */
+double wagner_pmax(double t, double s, double sdot, double eps) {
+    wagner_dependents w = wagner_s_dependents(t, s, sdot, 0.);
+    return w.ddot * w.ddot / (2. * eps * eps);
+}
+
+/* Solution for the plate displacement coupled to the composite force,
+replacing s_solution.m. Solves
+    ALPHA s'' / eps^2 + BETA s' + eps^2 GAMMA s = F(t, s, s', s'')
+from s = s' = 0 at t = 0 for n steps of size dt, writing t, s, s' and s''
+into the arrays (which may be NULL). The outer force is linear in s'', with
+added mass 4 sqrt(3) eps (t - s)^(3/2), so s'' is found implicitly which keeps
+the explicit RK2 steps stable at early times */
+double wagner_plate_acceleration(double t, double s, double sdot, \
+        double alpha, double beta, double gamma, double eps) {
+    double tau = t - s;
+    double added_mass = tau > 0. ? 4. * sqrt(3.) * eps * pow(tau, 1.5) : 0.;
+    double force = wagner_composite_force(t, s, sdot, 0., eps);
+    return (force - beta * sdot - eps * eps * gamma * s) \
+        / (alpha / (eps * eps) + added_mass);
+}
+
+void wagner_plate_solution(double alpha, double beta, double gamma, \
+        double eps, double dt, int n, double * ts, double * ss, \
+        double * sdots, double * sddots) {
+    double t = 0., s = 0., sdot = 0.;
+    for (int k = 0; k < n; k++) {
+        double sddot \
+            = wagner_plate_acceleration(t, s, sdot, alpha, beta, gamma, eps);
+        if (ts != NULL) ts[k] = t;
+        if (ss != NULL) ss[k] = s;
+        if (sdots != NULL) sdots[k] = sdot;
+        if (sddots != NULL) sddots[k] = sddot;
+
+        // Heun's method
+        double s_predict = s + dt * sdot;
+        double sdot_predict = sdot + dt * sddot;
+        double sddot_predict = wagner_plate_acceleration(t + dt, s_predict, \
+            sdot_predict, alpha, beta, gamma, eps);
+        s += dt * (sdot + sdot_predict) / 2.;
+        sdot += dt * (sddot + sddot_predict) / 2.;
+        t += dt;
+    }
+}
+
+#endif
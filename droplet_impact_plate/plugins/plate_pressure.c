@@ -0,0 +1,73 @@
+/* plate_pressure.c
+    Example analysis plugin (see droplet_impact_plate/code/plugin_api.h).
+    Each time the force on the plate is evaluated, the pressure is sampled
+    along the plate to find its maximum and where it occurs, which are written
+    to the shared output together with the turnover point and maximum pressure
+    of Wagner theory for the current plate motion. Every few steps the volume
+    of the liquid is also written, to check for mass loss (e.g. from the 
+    droplet removal).
+
+    Arguments (both optional): POINTS VOLUME_INTERVAL
+        POINTS: number of points the pressure is sampled at (default 200)
+        VOLUME_INTERVAL: steps between volume outputs (default 100, 0 for none)
+*/
+
+#include "plugin_api.h"
+#include "wagner.h"
+#include <stdlib.h>
+
+static int points = 200;
+static int volume_interval = 100;
+static double plate_width = 2.; // Radial extent of the sampled plate
+static double initial_volume = -1.;
+
+static int init(const plugin_host * host, const plugin_state * state, \
+        const char * args) {
+    sscanf(args, "%d %d", &points, &volume_interval);
+    return points > 1 ? 0 : -1;
+}
+
+static void plate_force(const plugin_host * host, \
+        const plugin_state * state) {
+    double p_max = 0., r_max = 0.;
+    for (int k = 0; k < points; k++) {
+        double r = plate_width * k / (points - 1);
+        double p = host->field_value("p", 1e-9, r);
+        if (p > p_max) {
+            p_max = p;
+            r_max = r;
+        }
+    }
+    double tau = state->t - state->impact_time;
+    wagner_dependents w \
+        = wagner_s_dependents(tau, state->s, state->sdot, state->sddot);
+    host->print("plate_pressure", \
+        "p_max = %g, r_max = %g, wagner_d = %g, wagner_pmax = %g", \
+        p_max, r_max, w.d, wagner_pmax(tau, state->s, state->sdot, 1.));
+}
+
+/* Volume of the liquid, where cells are rings about the axis y = 0 */
+static double liquid_volume(const plugin_host * host) {
+    const char * fields[] = {"f"};
+    long n = host->leaf_cells(fields, 1, NULL, 0);
+    double * cells = malloc(4 * n * sizeof(double));
+    host->leaf_cells(fields, 1, cells, n);
+    double volume = 0.;
+    for (long k = 0; k < n; k++) {
+        double * cell = &cells[4 * k];
+        volume += 2. * M_PI * cell[1] * cell[2] * cell[2] * cell[3];
+    }
+    free(cells);
+    return volume;
+}
+
+static void step(const plugin_host * host, const plugin_state * state) {
+    if (volume_interval <= 0 || state->i % volume_interval != 0) return;
+    double volume = liquid_volume(host);
+    if (initial_volume < 0.) initial_volume = volume;
+    host->print("plate_pressure", "volume = %g, volume_change = %g", \
+        volume, volume / initial_volume - 1.);
+}
+
+const plugin_definition plugin = {PLUGIN_API_VERSION, "plate_pressure", \
+    init, step, plate_force, NULL};
@@ -0,0 +1,133 @@
+#!/bin/bash
+
+# compare_traces.sh
+# Compares the cleaned output of a run against reference data, using the 
+# tolerances given in tolerances.txt. It takes two inputs:
+# Input 1: Directory of the run (after output_clean.sh has been called on it)
+# Input 2: Directory of the reference data, containing output.txt and the
+#          directory plate_outputs (i.e. the cleaned_data of the reference run)
+# Input 3: Largest y to compare the plate profiles up to (optional, default
+#          the whole of the profiles)
+# For each quantity, the error is the maximum difference from the reference 
+# values divided by the maximum magnitude of the reference values. The log 
+# quantities are compared at matching times, and the plate quantities are 
+# compared over all of the plate output files. The plate profiles of the run
+# are linearly interpolated in y onto the positions of the reference, so runs
+# with different adapted grids along the plate can be compared. Exits with 1 if
+# any of the quantities are outside of their tolerance.
+
+RUN_DIR=$1
+REF_DIR=$2
+Y_MAX=$3
+
+SCRIPT_DIR=$(dirname $(realpath $0))
+CLEANED_DIR=$RUN_DIR/cleaned_data
+
+FAILURES=0
+
+# Prints the error of a quantity and whether it is within tolerance, and 
+# records the failure if not
+report() {
+    NAME=$1; ERROR=$2; TOLERANCE=$3
+    if awk -v e=$ERROR -v tol=$TOLERANCE 'BEGIN { exit !(e != "nan" && e <= tol) }'; then
+        printf "    %-12s error = %-12g (tolerance %g) OK\n" $NAME $ERROR $TOLERANCE
+    else
+        printf "    %-12s error = %-12s (tolerance %g) FAILED\n" $NAME $ERROR $TOLERANCE
+        FAILURES=$((FAILURES + 1))
+    fi
+}
+
+# Relative maximum error between the given columns of two log files, where the
+# rows are matched by the value of the first column (time). Rows of the run with
+# no matching time in the reference are ignored, but a reference time missing 
+# from the run gives an error of nan.
+max_error() {
+    awk -F ', *|,' -v col=$1 '
+        FNR == NR {
+            key = $1
+            ref[key] = $col
+            if ($col > max_ref) max_ref = $col
+            if (-$col > max_ref) max_ref = -$col
+            next
+        }
+        {
+            key = $1
+            if (key in ref) {
+                diff = $col - ref[key]
+                if (diff < 0) diff = -diff
+                if (diff > max_diff) max_diff = diff
+                found[key] = 1
+            }
+        }
+        END {
+            for (key in ref) if (!(key in found)) { print "nan"; exit }
+            if (max_ref == 0) max_ref = 1
+            print max_diff / max_ref
+        }' $2 $3
+}
+
+# Relative maximum error between the given column of a reference plate profile
+# and the run profile interpolated to the same y (the first column). Reference
+# points above Y_MAX or outside of the range of the run are skipped, and if no
+# points are left the error is nan.
+profile_error() {
+    awk -F ', *|,' -v col=$1 -v y_max="$Y_MAX" '
+        BEGIN { n = 0 }
+        FNR == NR {
+            # Run profile, sorted by y
+            ys[n] = $1
+            values[n] = $col
+            n++
+            next
+        }
+        {
+            y = $1
+            if ((y_max != "" && y > y_max + 0) || n == 0 || y < ys[0] \
+                    || y > ys[n - 1]) next
+            low = 0
+            high = n - 1
+            while (high - low > 1) {
+                middle = int((low + high) / 2)
+                if (ys[middle] <= y) low = middle; else high = middle
+            }
+            w = ys[high] > ys[low] ? (y - ys[low]) / (ys[high] - ys[low]) : 0
+            value = (1 - w) * values[low] + w * values[high]
+            diff = value - $col
+            if (diff < 0) diff = -diff
+            if (diff > max_diff) max_diff = diff
+            if ($col > max_ref) max_ref = $col
+            if (-$col > max_ref) max_ref = -$col
+            compared++
+        }
+        END {
+            if (compared == 0) { print "nan"; exit }
+            if (max_ref == 0) max_ref = 1
+            print max_diff / max_ref
+        }' <(sort -t , -g -k 1,1 $3) $2
+}
+
+while read KIND NAME COLUMN TOLERANCE
+do
+    if [ "$KIND" == "log" ]; then
+        ERROR=$(max_error $COLUMN $REF_DIR/output.txt $CLEANED_DIR/output.txt)
+    else
+        # Maximum error over all of the plate output files of the reference
+        ERROR=0
+        for REF_FILE in $REF_DIR/plate_outputs/output_*.txt
+        do
+            RUN_FILE=$CLEANED_DIR/plate_outputs/$(basename $REF_FILE)
+            if [ ! -f $RUN_FILE ]; then
+                ERROR=nan
+                break
+            fi
+            FILE_ERROR=$(profile_error $COLUMN $REF_FILE $RUN_FILE)
+            ERROR=$(awk -v a=$ERROR -v b=$FILE_ERROR \
+                'BEGIN { print (b == "nan" || a == "nan") ? "nan" : (b > a ? b : a) }')
+        done
+    fi
+    report $NAME $ERROR $TOLERANCE
+done < <(grep -v '^#' $SCRIPT_DIR/tolerances.txt)
+
+if [ $FAILURES -gt 0 ]; then
+    exit 1
+fi
@@ -0,0 +1,56 @@
+#!/bin/bash
+
+# far_field_validation.sh
+# Validates the far-field boundary conditions (FAR_FIELD_BC) by checking that
+# the plate force and pressure are independent of the box size. A stationary
+# axisymmetric plate is run in the default box (BOX_WIDTH = 6) with the 
+# Dirichlet pressure conditions as the reference, and in a box of half the 
+# width (with one less level, so the same minimum cell size) with both the
+# Dirichlet and the far-field conditions. The half boxes are compared against
+# the reference using compare_traces.sh, with the pressure profiles compared
+# over the width of the plate, which both boxes contain.
+# Input 1: Directory to run the cases in (preferably on scratch)
+# Input 2: Number of threads to run each case on (default 1)
+# Input 3: MAXLEVEL of the reference case (default 11)
+# Exits with 1 if the far-field half box is outside of the tolerances in 
+# tolerances.txt. The Dirichlet half box is only reported, as it is expected 
+# to fail.
+
+RUN_DIR=$(realpath $1)
+CORES=${2:-1}
+LEVEL=${3:-11}
+
+SCRIPT_DIR=$(dirname $(realpath $0))
+UTILITY_DIR=$SCRIPT_DIR/../utility_scripts
+
+export RESULT_CACHE=0
+
+COMMON="AXISYMMETRIC=1 CONST_ACC=1 PLATE_ACC=0.0 HARD_MAX_TIME=0.3 MOVIES=0"
+
+# Runs a case with the given name and parameters, then cleans the output
+run_case() {
+    CASE=$1
+    shift
+    echo Running $CASE
+    rm -rf $RUN_DIR/$CASE
+    cd $UTILITY_DIR
+    ./code_copy.sh ../droplet_impact_plate $RUN_DIR $CASE
+    ./set_parameters.sh $RUN_DIR/$CASE/code/parameters.h $COMMON "$@"
+    cd $RUN_DIR/$CASE/code
+    ./run_simulation.sh droplet_impact_plate $CORES > /dev/null 2>&1
+    cd $UTILITY_DIR
+    ./output_clean.sh $RUN_DIR/$CASE > /dev/null 2>&1
+}
+
+mkdir -p $RUN_DIR
+run_case box_6 BOX_WIDTH=6.0 MAXLEVEL=$LEVEL FAR_FIELD_BC=0
+run_case box_3_dirichlet BOX_WIDTH=3.0 MAXLEVEL=$((LEVEL - 1)) FAR_FIELD_BC=0
+run_case box_3_far_field BOX_WIDTH=3.0 MAXLEVEL=$((LEVEL - 1)) FAR_FIELD_BC=1
+
+REFERENCE=$RUN_DIR/box_6/cleaned_data
+PLATE_WIDTH=$(sed -nE 's/^const double PLATE_WIDTH = ([^;]*);.*/\1/p' \
+    $RUN_DIR/box_6/code/parameters.h)
+echo "Half box with Dirichlet conditions:"
+$SCRIPT_DIR/compare_traces.sh $RUN_DIR/box_3_dirichlet $REFERENCE $PLATE_WIDTH
+echo "Half box with far-field conditions:"
+$SCRIPT_DIR/compare_traces.sh $RUN_DIR/box_3_far_field $REFERENCE $PLATE_WIDTH
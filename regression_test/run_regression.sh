@@ -0,0 +1,64 @@
+#!/bin/bash
+
+# run_regression.sh
+# Runs the reference cases listed in cases.txt and compares their force trace, 
+# plate position s(t), bubble area and plate pressure profiles against the 
+# stored reference data in the reference directory, using compare_traces.sh.
+# It takes three inputs:
+# Input 1: Directory to run the cases in (preferably on scratch)
+# Input 2: Number of threads to run each case on (default 1)
+# Input 3: Set to "update" to replace the reference data with the results of
+#          this run, instead of comparing against it
+# Exits with 1 if any case is outside of the tolerances in tolerances.txt.
+
+RUN_DIR=$(realpath $1)
+CORES=${2:-1}
+UPDATE=$3
+
+# Directories of the regression scripts and utility scripts
+SCRIPT_DIR=$(dirname $(realpath $0))
+UTILITY_DIR=$SCRIPT_DIR/../utility_scripts
+REFERENCE_DIR=$SCRIPT_DIR/reference
+
+# The cases must always run, so the result cache is turned off
+export RESULT_CACHE=0
+
+mkdir -p $RUN_DIR
+FAILED_CASES=""
+
+while read CASE PARAMETERS
+do
+    echo Running regression case $CASE
+
+    # Copies the code and sets the parameters of the case
+    rm -rf $RUN_DIR/$CASE
+    cd $UTILITY_DIR
+    ./code_copy.sh ../droplet_impact_plate $RUN_DIR $CASE
+    ./set_parameters.sh $RUN_DIR/$CASE/code/parameters.h $PARAMETERS
+
+    # Runs the case and cleans the output
+    cd $RUN_DIR/$CASE/code
+    ./run_simulation.sh droplet_impact_plate $CORES > /dev/null 2>&1
+    cd $UTILITY_DIR
+    ./output_clean.sh $RUN_DIR/$CASE > /dev/null 2>&1
+
+    if [ "$UPDATE" == "update" ]; then
+        # Stores the cleaned log and plate outputs as the new reference
+        rm -rf $REFERENCE_DIR/$CASE
+        mkdir -p $REFERENCE_DIR/$CASE
+        cp $RUN_DIR/$CASE/cleaned_data/output.txt $REFERENCE_DIR/$CASE
+        cp -r $RUN_DIR/$CASE/cleaned_data/plate_outputs $REFERENCE_DIR/$CASE
+        echo Updated reference data for $CASE
+    elif [ ! -d $REFERENCE_DIR/$CASE ]; then
+        echo "No reference data for $CASE, create it with the update option"
+        FAILED_CASES="$FAILED_CASES $CASE"
+    elif ! $SCRIPT_DIR/compare_traces.sh $RUN_DIR/$CASE $REFERENCE_DIR/$CASE; then
+        FAILED_CASES="$FAILED_CASES $CASE"
+    fi
+done < <(grep -v '^#' $SCRIPT_DIR/cases.txt)
+
+if [ -n "$FAILED_CASES" ]; then
+    echo "Regression test failed for:$FAILED_CASES"
+    exit 1
+fi
+echo "Regression test passed"
@@ -19,4 +19,12 @@ mkdir ${DEST_DIR}/${SUB_DIR_NAME}
 cp -r ${LOCAL_DIR}/code ${DEST_DIR}/${SUB_DIR_NAME}
 
 # Copies the run script, Makefile and parameters over to the destination
-cp {run_simulation.sh,Makefile,parameters.h} ${DEST_DIR}/${SUB_DIR_NAME}/code
+cp {run_simulation.sh,result_cache.sh,Makefile,parameters.h} \
+    ${DEST_DIR}/${SUB_DIR_NAME}/code
+
+# Reports if this parameter set has already been computed, in which case 
+# run_simulation.sh will reuse the cached output instead of running
+CACHED_DIR=$(./result_cache.sh lookup ${DEST_DIR}/${SUB_DIR_NAME}/code)
+if [ $? -eq 0 ]; then
+    echo ${SUB_DIR_NAME}: already computed, will reuse $CACHED_DIR
+fi
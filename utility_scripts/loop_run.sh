@@ -1,14 +1,32 @@
 #!/bin/bash
 # Sequentially runs all of the scripts in a given parent directory
+# If cores is "auto", each run is first checked with preflight.sh (using any
+# finished runs given after the cores as history), runs it estimates to be
+# infeasible are skipped and the others use its suggested number of threads
 
 parent_dir=$1
 code_name=$2
 cores=$3
+shift 3
+history_dirs=$(for dir in "$@"; do realpath $dir; done)
+
+script_dir=$(dirname $(realpath $0))
 
 for DIR_NAME in $parent_dir/*/
 do
     echo $DIR_NAME
     cd $DIR_NAME/code
 
-    ./run_simulation.sh $code_name $cores
+    run_cores=$cores
+    if [ "$cores" == "auto" ]; then
+        preflight_output=$($script_dir/preflight.sh . $history_dirs)
+        if [ $? -ne 0 ]; then
+            echo "$preflight_output"
+            echo "Skipping $DIR_NAME, estimated to be infeasible"
+            continue
+        fi
+        run_cores=$(echo "$preflight_output" | awk '$1 == "threads" { print $3 }')
+    fi
+
+    ./run_simulation.sh $code_name $run_cores
 done
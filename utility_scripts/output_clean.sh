@@ -25,6 +25,17 @@ RAW_DATA_DIR=${PARENT_DIR}/raw_data
 # Directory where the cleaned data is stored
 CLEANED_DATA_DIR=${PARENT_DIR}/cleaned_data
 
+# Runs with ARCHIVE_OUTPUT write their outputs into the single file run.rca, 
+# which is extracted first to give the usual files
+SCRIPT_DIR=$(dirname $(realpath $0))
+ARCHIVE_TOOL=${SCRIPT_DIR}/../data_analysis/archive/run_archive_tool
+if [ -f ${RAW_DATA_DIR}/run.rca ]; then
+    if [ ! -x ${ARCHIVE_TOOL} ]; then
+        make -C $(dirname ${ARCHIVE_TOOL}) > /dev/null
+    fi
+    ${ARCHIVE_TOOL} extract ${RAW_DATA_DIR}/run.rca
+fi
+
 # Creates the directories to store cleaned data
 mkdir ${CLEANED_DATA_DIR}
 mkdir ${CLEANED_DATA_DIR}/plate_outputs
@@ -76,8 +87,12 @@ mv ${RAW_DATA_DIR}/*.mp4 ${MOVIE_DIR}
 GFS_DIR=${PARENT_DIR}/gfs_files
 mkdir ${GFS_DIR}
 
-# Moves all the gfs files from the raw_data direcotry into the movies directory
-mv ${RAW_DATA_DIR}/*.gfs ${GFS_DIR}
+# Moves all the gfs files from the raw_data direcotry into the movies directory.
+# There are none if the run wrote compressed snapshots, which are left in 
+# raw_data with the field outputs
+if ls ${RAW_DATA_DIR}/*.gfs > /dev/null 2>&1; then
+    mv ${RAW_DATA_DIR}/*.gfs ${GFS_DIR}
+fi
 
 ################################################################################
 # Moves the interface files into a separate directory
@@ -90,6 +105,17 @@ mkdir ${INTERFACE_DIR}
 # Moves all the gfs files from the raw_data direcotry into the movies directory
 mv ${RAW_DATA_DIR}/interface_*.txt ${INTERFACE_DIR}
 
+################################################################################
+# Moves the region of interest files into a separate directory
+################################################################################
+
+# These are only written if ROI_TRACK was set
+if ls ${RAW_DATA_DIR}/roi_output_*.txt > /dev/null 2>&1; then
+    ROI_DIR=${PARENT_DIR}/roi_outputs
+    mkdir ${ROI_DIR}
+    mv ${RAW_DATA_DIR}/roi_output_*.txt ${RAW_DATA_DIR}/roi_times.txt ${ROI_DIR}
+fi
+
 ################################################################################
 # Cleans the plate output files
 ################################################################################
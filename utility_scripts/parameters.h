@@ -45,20 +45,71 @@ and not related to the actual physics */
 // General
 const double HARD_MAX_TIME = 0.41; // Hard maximum time (end time may be shorter)
 const double BOX_WIDTH = 6.0; // Width of the computational box
+const int FAR_FIELD_BC = 0; // If 1, use decaying far-field pressure conditions on the top and right boundaries
+const int PREFLIGHT = 0; // If 1, only build the initial grid and report its size to preflight.txt
 const double FORCE_DELAY_TIME = 0.01; // Delay time before force is applied on plate
+// Diagnostic sampling. Set to 1 for the plate motion, droplet removal and log 
+// events to run every solver step instead of at fixed times, so that they do
+// not limit the timestep. The log is then interpolated to LOG_OUTPUT_TIMESTEP
+#define DIAGNOSTIC_SAMPLING 0
+const double SAMPLING_MAX_DT = 1e-3; // Maximum timestep with diagnostic sampling
+// Poisson solver options
+const int TOLERANCE_SCHEDULE = 0; // If 1, relax the solver tolerance away from impact
+const double COARSE_TOLERANCE = 1e-3; // Relaxed Poisson solver tolerance
+const int COARSE_NITERMAX = 100; // Relaxed maximum number of solver iterations
+const double FINE_TOLERANCE_GAP = 0.05; // Gap below which the full tolerance is used
+const double FINE_TOLERANCE_END_TIME = 2.0; // Time after which to relax the tolerance again
+const double PINCH_OFF_WINDOW = 0.01; // Time after pinch-off using the full tolerance
+const int PRESSURE_EXTRAPOLATION = 0; // If 1, extrapolate the pressure to warm start the solver
 // Refinement options
 const int MINLEVEL = 5; // Minimum refinement level 
 const int MAXLEVEL = 13; // Maximum refinement level
 const int PLATE_REFINE_NO = 4; // Number of max refinement cells above plate
 const double DROP_REFINED_WIDTH = 0.04; // width of refined region around droplet
 // Output options
-const int MOVIES = 0; // Set 1 to produce movies
+#define MOVIES 0 // Set 1 to produce movies (needs the GL libraries for bview)
+const int MOVIE_SNAPSHOTS = 0; // Set 1 to save snapshots for the offline movie renderer
 const double START_OUTPUT_TIME = 0.0; // Time to start outputs
 const double END_OUTPUT_TIME = 2.0; // Time to end outputs
 const double GFS_OUTPUT_TIMESTEP = 1e-2; // Time between gfs outputs
+const int COMPRESSED_OUTPUT = 0; // If 1, replace the gfs and field outputs by compressed snapshots
+const double F_ERROR_BOUND = 1e-6; // Error bound of the volume fraction in compressed snapshots
+const double P_ERROR_BOUND = 1e-4; // Error bound of the pressure in compressed snapshots
+const double U_ERROR_BOUND = 1e-4; // Error bound of the velocity in compressed snapshots
+const int ARCHIVE_OUTPUT = 0; // If 1, write the outputs into the single file run.rca
+const char * PLUGIN_FILE = "../plugins.txt"; // List of analysis plugins to load (none if missing)
 const double PLATE_OUTPUT_TIMESTEP = 1e-3; // Time between plate outputs
 const double LOG_OUTPUT_TIMESTEP = 1e-4; // Time between log outputs
 const double INTERFACE_OUTPUT_TIMESTEP = 1e-3; // Time between interface outputs
+// Region of interest output, with the fields at the full resolution of the 
+// grid in a square window which follows the region given by ROI_TRACK:
+// 1 = turnover point (the pressure peak on the plate), 2 = jet tip (the edge 
+// of the wetted plate), 3 = entrapped bubble (its centroid)
+const int ROI_TRACK = 0; // Region to follow (0 for no region of interest output)
+const double ROI_HALF_WIDTH = 0.05; // Half-width of the square window
+const double ROI_OUTPUT_TIMESTEP = 1e-3; // Time between region outputs
+// Tracer particles, which are seeded in the air film between the droplet and
+// the plate at the start and in the jet after impact, and written to the
+// trajectory stream tracers.trj
+const int TRACER_NO = 0; // Number of tracers in each seeding (0 for no tracers)
+const double TRACER_FILM_WIDTH = 0.2; // Radial extent of the air film seeded at the start
+const double TRACER_JET_DELAY = 0.01; // Time after impact to seed the jet
+const double TRACER_JET_WIDTH = 0.02; // Half-width of the region seeded around the turnover point
+const double TRACER_OUTPUT_TIMESTEP = 1e-3; // Time between trajectory frames
+// Adaptive output cadence. Set to 1 for the plate, interface, region of 
+// interest and gfs outputs to be written more often near impact, pinch-off 
+// and peaks in the force and less often elsewhere, relative to the intervals
+// above
+#define ADAPTIVE_OUTPUT 0
+const double ADAPTIVE_OUTPUT_FACTOR = 10.; // Times denser at events
+const double ADAPTIVE_OUTPUT_RELAX = 2.; // Up to this many times sparser elsewhere
+const double ADAPTIVE_OUTPUT_WINDOW = 5e-3; // Time for the cadence to relax
+const int ADAPTIVE_OUTPUT_BUDGET = 1000; // Maximum outputs of each kind in a run
+const int SOLVER_STATS = 0; // If 1, output multigrid solver stats every step
+const int MEMORY_STATS = 0; // If 1, output the memory of the fields every 0.01
+const int WAGNER_OUTPUT = 0; // If 1, output force / Wagner force (axisymmetric only)
+const double METRICS_INTERVAL = 0.; // Wall seconds between rewrites of metrics.prom (0 to disable)
+const int METRICS_PORT = 0; // Local port to serve the metrics over HTTP on (0 to disable)
 // Removal options
 const double REMOVAL_DELAY = 0.005; // Time after pinch-off to start removal
 const int REMOVE_ENTRAPMENT = 0; // If 1, completely remove entrapped air
@@ -68,5 +119,8 @@ const int PEAK_LAG = 4; // Lag used in peak detection
 const double PEAK_THRESHOLD = 4.0; // Number of std devs away from mean
 const double PEAK_INFLUENCE = 0.1; // Influence weighting from peak data
 const double PEAK_DELAY = 0.135; // Delay before peak detection starts
+const int WAGNER_PREDICTOR = 0; // If 1, replace peaks using the Wagner theory force
+// Added mass options
+const int IMPLICIT_ADDED_MASS = 0; // If 1, implicit added mass force (no peak detect)
 
 
@@ -0,0 +1,151 @@
+#!/bin/bash
+
+# preflight.sh
+# Script to estimate the cost of a run before launching it. The code in 
+# CODE_DIR is built and run in preflight mode (PREFLIGHT = 1), which builds the
+# initial grid from the initial condition and refinement criteria without
+# time-stepping and reports its size to preflight.txt. The wall time, memory 
+# and number of steps of the full run are then extrapolated with a model fitted
+# to the logstats.dat files of previous runs.
+#
+# Usage:
+# ./preflight.sh CODE_DIR [HISTORY_DIR ...]
+# where CODE_DIR is the code directory of a run (as made by code_copy.sh) and 
+# each HISTORY_DIR is a finished run directory containing raw_data/logstats.dat
+# (or logstats.dat) and code/parameters.h. Without any history only the grid
+# and memory are reported.
+#
+# The model assumes the wall time is proportional to the number of cell 
+# updates, with the cost per cell update, the growth of the number of cells 
+# over the run and the number of steps per unit time taken from the history. 
+# The number of steps is scaled by 2 per extra level, as the timestep is 
+# limited by the minimum cell size.
+#
+# The last lines of the output are the suggested number of threads and whether
+# the run is feasible, which is false if it needs more memory than 
+# MEMORY_LIMIT_MB (default the total memory of the machine) or more wall time
+# than TIME_LIMIT_HOURS (default 168). Exits with 1 if the run is infeasible.
+
+CODE_DIR=$(realpath $1)
+shift
+HISTORY_DIRS="$@"
+
+SCRIPT_DIR=$(dirname $(realpath $0))
+MEMORY_LIMIT_MB=${MEMORY_LIMIT_MB:-$(awk '/MemTotal/ { print $2 / 1024 }' /proc/meminfo)}
+TIME_LIMIT_HOURS=${TIME_LIMIT_HOURS:-168}
+
+# Value of a parameter in a parameters.h file
+parameter() {
+    sed 's|//.*$||' $2 | awk -v name=$1 '
+        $1 == "#define" && $2 == name { print $3 }
+        $1 == "const" && $3 == name { value = $5; sub(/;.*$/, "", value); print value }'
+}
+
+################################################################################
+# Preflight run
+################################################################################
+# Runs in a copy of the code so the code directory is left untouched
+PREFLIGHT_DIR=$(mktemp -d)
+cp $CODE_DIR/* $PREFLIGHT_DIR
+$SCRIPT_DIR/set_parameters.sh $PREFLIGHT_DIR/parameters.h PREFLIGHT=1 MOVIES=0
+cd $PREFLIGHT_DIR
+make droplet_impact_plate.tst > preflight_build.txt 2>&1
+if [ ! -f droplet_impact_plate/preflight.txt ]; then
+    echo "Preflight run failed, see $PREFLIGHT_DIR/preflight_build.txt"
+    exit 1
+fi
+cp droplet_impact_plate/preflight.txt $CODE_DIR
+cd - > /dev/null
+rm -rf $PREFLIGHT_DIR
+
+echo "Initial grid:"
+sed 's/^/    /' $CODE_DIR/preflight.txt
+
+value() {
+    awk -v name=$1 '$1 == name { print $3 }' $CODE_DIR/preflight.txt
+}
+LEVEL=$(value MAXLEVEL)
+CELLS=$(value leaf_cells)
+RSS=$(value peak_rss_mb)
+MAX_TIME=$(value max_time)
+
+################################################################################
+# Cost model from the history
+################################################################################
+# For each previous run, finds the cost per cell update, the growth of the
+# number of cells relative to the first logstats entry and the number of steps
+# per unit time, with the steps scaled to the level of this run
+MODEL=$(for DIR in $HISTORY_DIRS
+do
+    LOGSTATS=$DIR/raw_data/logstats.dat
+    [ -f $LOGSTATS ] || LOGSTATS=$DIR/logstats.dat
+    [ -f $LOGSTATS ] || continue
+    HISTORY_LEVEL=$(parameter MAXLEVEL $DIR/code/parameters.h)
+    awk -v level=$LEVEL -v history_level=${HISTORY_LEVEL:-$LEVEL} '
+        # Line format: i: I t: T dt: DT #Cells: N Wall clock time (s): W ...
+        {
+            i = $2; t = $4; cells = $8; wall = $13
+            if (NR == 1) first_cells = cells
+            else {
+                updates += (i - i_previous) * (cells + cells_previous) / 2
+                time += wall - wall_previous
+            }
+            cell_sum += cells
+            i_previous = i; cells_previous = cells; wall_previous = wall
+            t_last = t
+        }
+        END {
+            if (NR < 2 || updates == 0 || t_last == 0) exit
+            print time / updates, cell_sum / NR / first_cells, \
+                i_previous / t_last * 2 ^ (level - history_level)
+        }' $LOGSTATS
+done | awk '
+    { cost += $1; growth += $2; steps += $3; n++ }
+    END { if (n > 0) print cost / n, growth / n, steps / n, n }')
+
+if [ -z "$MODEL" ]; then
+    echo "No history given, so the wall time is not estimated"
+    COST=0
+    GROWTH=1
+    STEPS_PER_TIME=0
+else
+    read COST GROWTH STEPS_PER_TIME RUN_NO <<< "$MODEL"
+    echo "Cost model from $RUN_NO previous runs:"
+    echo "    Wall time per cell update (s): $COST"
+    echo "    Mean cells / initial cells: $GROWTH"
+    echo "    Steps per unit time at level $LEVEL: $STEPS_PER_TIME"
+fi
+
+################################################################################
+# Estimate
+################################################################################
+awk -v cells=$CELLS -v rss=$RSS -v max_time=$MAX_TIME -v cost=$COST \
+    -v growth=$GROWTH -v steps_per_time=$STEPS_PER_TIME \
+    -v memory_limit=$MEMORY_LIMIT_MB -v time_limit=$TIME_LIMIT_HOURS \
+    -v cores=$(nproc) '
+    BEGIN {
+        mean_cells = cells * growth
+        steps = steps_per_time * max_time
+        # Memory scales with the number of cells, from the preflight grid
+        memory = rss * growth
+        hours = cost * mean_cells * steps / 3600
+
+        # OpenMP only scales while each thread has enough cells, taken as 
+        # roughly 20000 leaf cells per thread
+        threads = int(mean_cells / 20000)
+        if (threads < 1) threads = 1
+        if (threads > cores) threads = cores
+
+        feasible = (memory <= memory_limit) && (hours <= time_limit)
+
+        printf "Estimate:\n"
+        printf "    Mean cells: %d\n", mean_cells
+        printf "    Memory (MB): %g\n", memory
+        if (steps > 0) {
+            printf "    Steps: %d\n", steps
+            printf "    Wall time on the history thread count (hours): %g\n", hours
+        }
+        printf "threads = %d\n", threads
+        printf "feasible = %d\n", feasible
+        exit !feasible
+    }'
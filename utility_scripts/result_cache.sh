@@ -0,0 +1,175 @@
+#!/bin/bash
+
+# result_cache.sh
+# Script to maintain a store of finished simulation outputs, so that parameter
+# combinations which have already been computed are never run twice. Each
+# result is keyed by a hash of the resolved parameters in parameters.h, of
+# the source code (the .c and .h files in the code directory) and of the build
+# (the Makefile, CC and CFLAGS and the Basilisk installation), so changing any
+# of them gives a different key.
+#
+# Usage:
+# ./result_cache.sh key CODE_DIR
+#   Prints the cache key for the code in CODE_DIR
+# ./result_cache.sh lookup CODE_DIR
+#   Prints the cached raw_data directory for CODE_DIR, exits with 1 if there
+#   is no finished result in the cache
+# ./result_cache.sh store CODE_DIR RAW_DATA_DIR
+#   Registers RAW_DATA_DIR as the finished output of the code in CODE_DIR
+#
+# The cache is stored in the directory given by the RESULT_CACHE_DIR
+# environment variable (default ~/droplet_impact_cache). Setting
+# RESULT_CACHE=0 disables all lookups and stores.
+
+MODE=$1 # Either key, lookup or store
+CODE_DIR=$2 # Directory containing the code and parameters.h
+RAW_DATA_DIR=$3 # Directory of outputs to store (store mode only)
+
+# Location of the cache
+CACHE_DIR=${RESULT_CACHE_DIR:-$HOME/droplet_impact_cache}
+
+# Directory inside CODE_DIR that the simulation runs in (named after the 
+# driver by the Basilisk Makefile), which relative plugin paths are resolved 
+# from
+RUN_NAME=droplet_impact_plate
+
+# Exits straight away if the cache has been disabled
+if [ "${RESULT_CACHE:-1}" == "0" ]; then
+    exit 1
+fi
+
+################################################################################
+# Canonical form of the parameters
+################################################################################
+# Extracts every "#define NAME VALUE" and "const TYPE NAME = VALUE;" line from
+# parameters.h as NAME=VALUE, with comments and whitespace removed and numeric
+# values normalised (so 2, 2. and 2.0 all give the same key). The lines are
+# sorted so that reordering parameters.h does not change the key.
+canonical_parameters() {
+    sed 's|//.*$||' $1/parameters.h | awk '
+        function normalise(value) {
+            if (value ~ /^[-+]?([0-9]+\.?[0-9]*|\.[0-9]+)([eE][-+]?[0-9]+)?$/) {
+                return sprintf("%.17g", value + 0)
+            }
+            return value
+        }
+        $1 == "#define" && NF >= 3 {
+            print $2 "=" normalise($3)
+        }
+        $1 == "const" {
+            line = $0
+            sub(/;.*$/, "", line)
+            split(line, sides, "=")
+            n = split(sides[1], lhs, " ")
+            value = sides[2]
+            gsub(/[ \t]/, "", value)
+            print lhs[n] "=" normalise(value)
+        }' | sort
+}
+
+################################################################################
+# Plugins
+################################################################################
+# Prints the name, arguments and hash of each plugin listed in plugins.txt, 
+# with relative paths resolved from the run directory as the simulation does. 
+# Returns 1 if a plugin cannot be hashed (e.g. it is missing, or is a bare 
+# name which dlopen searches the library path for), as the key would then not
+# change when the plugin is rebuilt
+plugin_hashes() {
+    [ -f $1/plugins.txt ] || return 0
+    grep -v '^#' $1/plugins.txt | while read PLUGIN ARGS
+    do
+        [ -z "$PLUGIN" ] && continue
+        case $PLUGIN in
+            /*) PLUGIN_PATH=$PLUGIN ;;
+            */*) PLUGIN_PATH=$(realpath -m $1/$RUN_NAME/$PLUGIN) ;;
+            *) PLUGIN_PATH= ;;
+        esac
+        [ -f "$PLUGIN_PATH" ] || exit 1
+        echo plugin $(basename $PLUGIN) $ARGS $(sha256sum < $PLUGIN_PATH)
+    done
+}
+
+################################################################################
+# Cache key
+################################################################################
+# Hash of the canonical parameters together with the hashes of all of the
+# source files other than parameters.h, which identifies the code version. The
+# analysis plugins listed in plugins.txt (and their arguments) are included, as
+# they add to the outputs, and so is the build, as the same code built with
+# different flags or another version of Basilisk can give different results.
+# Returns 1 if the plugins cannot be hashed
+cache_key() {
+    PLUGINS=$(plugin_hashes $1) || return 1
+    {
+        canonical_parameters $1
+        for SOURCE in $(ls $1/*.c $1/*.h 2> /dev/null | sort)
+        do
+            if [ "$(basename $SOURCE)" != "parameters.h" ]; then
+                echo $(basename $SOURCE) $(sha256sum < $SOURCE)
+            fi
+        done
+        [ -n "$PLUGINS" ] && echo "$PLUGINS"
+        echo Makefile $(sha256sum 2> /dev/null < $1/Makefile)
+        echo CC $CC CFLAGS $CFLAGS
+        for BUILD_FILE in $BASILISK/qcc $BASILISK/Makefile.defs
+        do
+            echo $(basename $BUILD_FILE) \
+                $(sha256sum 2> /dev/null < $BUILD_FILE)
+        done
+    } | sha256sum | cut -d ' ' -f 1
+}
+
+# Without a reliable key, nothing is looked up or stored
+if ! KEY=$(cache_key $CODE_DIR); then
+    echo "Could not hash the plugins in $CODE_DIR/plugins.txt, not using the" \
+        "result cache" >&2
+    exit 1
+fi
+ENTRY_DIR=$CACHE_DIR/$KEY
+
+if [ "$MODE" == "key" ]; then
+    echo $KEY
+
+elif [ "$MODE" == "lookup" ]; then
+    # A result only counts as finished once the complete marker is written
+    if [ -f $ENTRY_DIR/complete ]; then
+        echo $ENTRY_DIR/raw_data
+    else
+        exit 1
+    fi
+
+elif [ "$MODE" == "store" ]; then
+    # Only finished runs are stored, which write "Finished after" to the log
+    if ! grep -q "^Finished after" $RAW_DATA_DIR/log 2> /dev/null; then
+        echo "Run in $RAW_DATA_DIR did not finish, not storing in cache"
+        exit 1
+    fi
+
+    if [ -f $ENTRY_DIR/complete ]; then
+        exit 0
+    fi
+
+    mkdir -p $CACHE_DIR
+
+    # Copies into a temporary directory first so a partially copied result is
+    # never seen by lookup. The files are copied rather than hard linked, so
+    # editing the outputs of the run in place cannot change the cached copy,
+    # with copy-on-write clones used where the file system supports them
+    TMP_DIR=$(mktemp -d $CACHE_DIR/.tmp_XXXXXX)
+    cp -r --reflink=auto $RAW_DATA_DIR $TMP_DIR/raw_data
+    canonical_parameters $CODE_DIR > $TMP_DIR/parameters.txt
+    cp $CODE_DIR/parameters.h $TMP_DIR
+    touch $TMP_DIR/complete
+    rm -rf $ENTRY_DIR
+    mv $TMP_DIR $ENTRY_DIR
+
+    # Records the new entry in the index of the cache
+    echo $KEY, $(date +%Y-%m-%dT%H:%M:%S), $(realpath $CODE_DIR) \
+        >> $CACHE_DIR/index.txt
+    echo Stored result in cache with key $KEY
+
+else
+    echo "Usage: $0 key|lookup CODE_DIR, or $0 store CODE_DIR RAW_DATA_DIR"
+    exit 1
+fi
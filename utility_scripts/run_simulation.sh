@@ -5,7 +5,9 @@
 # Input 1: Name of the C file (without the .C extension)
 # Input 2: Number of threads to run the simulation on (default 1)
 # It removes any previous outputs, runs the code and then moves the output into 
-# a directory one level up called "raw_data"
+# a directory one level up called "raw_data". If the same parameters and code
+# have already been run, the output is taken from the result cache instead (see
+# result_cache.sh)
 
 # Saves script name, which will also be the name of the directory that the 
 #output gets saved for (crucially this does not contain the .c extension)
@@ -14,6 +16,15 @@ script_name=$1
 # Sets the number of OpenMP threads
 export OMP_NUM_THREADS=$2
 
+# If there is a finished result in the cache, reuse it instead of running
+CACHED_DIR=$(./result_cache.sh lookup .)
+if [ $? -eq 0 ]; then
+    echo Found cached result in $CACHED_DIR
+    rm -r ../raw_data
+    cp -r --reflink=auto $CACHED_DIR ../raw_data
+    exit 0
+fi
+
 # Deletes the previous directory and test files
 rm -r ${script_name}
 rm *.s
@@ -31,3 +42,5 @@ rm -r ../raw_data
 # Moves the new data to the parent directory
 mv ${script_name} ../raw_data
 
+# Registers the finished run in the result cache
+./result_cache.sh store . ../raw_data
@@ -0,0 +1,32 @@
+#!/bin/bash
+
+# set_parameters.sh
+# Script to change the values of parameters in a parameters.h file, in the same
+# way as the loop scripts do with sed. The first input is the parameters file,
+# and the rest are assignments of the form NAME=VALUE, e.g.
+# ./set_parameters.sh parameters.h MAXLEVEL=10 ALPHA=2.0 AXISYMMETRIC=1
+# where strings are given with their quotes, e.g. PLUGIN_FILE='"plugins.txt"'.
+# Works for both "#define NAME VALUE" and "const TYPE NAME = VALUE;" parameters,
+# keeping the comments after the values.
+
+PARAMETERS_FILE=$1
+shift
+
+for ASSIGNMENT in "$@"
+do
+    NAME=${ASSIGNMENT%%=*}
+    VALUE=${ASSIGNMENT#*=}
+
+    # The type may be a pointer, e.g. "const char * PLUGIN_FILE"
+    TYPE='const [a-z ]+\*? *'
+    if ! grep -q -E "^(#define |$TYPE)$NAME( |=)" $PARAMETERS_FILE; then
+        echo "Parameter $NAME not found in $PARAMETERS_FILE"
+        exit 1
+    fi
+
+    # | is used as the delimiter, so values can be paths
+    sed -i -E \
+        -e "s|^(#define $NAME )[^/]*[^/ ]( *//.*)?$|\1$VALUE\2|" \
+        -e "s|^($TYPE$NAME = )[^;]*;|\1$VALUE;|" \
+        $PARAMETERS_FILE
+done
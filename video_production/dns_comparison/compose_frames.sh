@@ -0,0 +1,99 @@
+#!/bin/bash
+
+# compose_frames.sh
+# Composes the side-by-side comparison videos of two or more runs in a single
+# ffmpeg pass, so the frames are only decoded and encoded once. The first run
+# (e.g. the stationary plate) is mirrored and the runs are stacked left to
+# right, then the result is optionally padded, scaled and stacked above any
+# number of graph videos, each with its own crop (or any other filters).
+#
+# Usage:
+# ./compose_frames.sh [options] OUTPUT RUN1 [RUN2 ...]
+# where each RUN is either a video or a directory of frames frame_%05d.ppm (as
+# kept by render_movie.sh with FRAMES_DIR, which avoids any lossy step before
+# the final encode). With a single RUN it is used as it is, without mirroring.
+# Options:
+# -g GRAPH      Graph video to stack underneath (can be repeated)
+# -c FILTERS    ffmpeg filters applied to the previous graph, e.g. 
+#               "crop=1516:250:170:250"
+# -p PAD        Pads the runs with the ffmpeg pad filter, e.g. 
+#               "width=2176:height=1152:x=103:y=0:color=white"
+# -w WIDTH      Scales the runs and graphs to this width
+# -r RATE       Frame rate of frame directories (default 25)
+
+GRAPHS=()
+GRAPH_FILTERS=()
+PAD=""
+WIDTH=""
+RATE=25
+
+while getopts "g:c:p:w:r:" OPTION
+do
+    case $OPTION in
+        g) GRAPHS+=("$OPTARG"); GRAPH_FILTERS+=("null") ;;
+        c) GRAPH_FILTERS[$((${#GRAPHS[@]} - 1))]="$OPTARG" ;;
+        p) PAD=$OPTARG ;;
+        w) WIDTH=$OPTARG ;;
+        r) RATE=$OPTARG ;;
+        *) exit 1 ;;
+    esac
+done
+shift $((OPTIND - 1))
+
+OUTPUT=$1
+shift
+RUNS=("$@")
+RUN_NO=${#RUNS[@]}
+
+if [ $RUN_NO -lt 1 ]; then
+    echo "Usage: $0 [options] OUTPUT RUN1 [RUN2 ...]"
+    exit 1
+fi
+
+# Input arguments, where frame directories are read as image sequences
+INPUTS=()
+for INPUT in "${RUNS[@]}" "${GRAPHS[@]}"
+do
+    if [ -d $INPUT ]; then
+        INPUTS+=(-framerate $RATE -i $INPUT/frame_%05d.ppm)
+    else
+        INPUTS+=(-i $INPUT)
+    fi
+done
+
+# Mirrors the first run and stacks the runs
+if [ $RUN_NO -eq 1 ]; then
+    FILTER="[0:v]null[dns]"
+else
+    FILTER="[0:v]hflip[run0]"
+    STACK="[run0]"
+    for ((k = 1; k < RUN_NO; k++))
+    do
+        STACK="$STACK[$k:v]"
+    done
+    FILTER="$FILTER;${STACK}hstack=inputs=$RUN_NO[dns]"
+fi
+
+# Pads and scales the runs
+CHAIN="null"
+[ -n "$PAD" ] && CHAIN="$CHAIN,pad=$PAD"
+[ -n "$WIDTH" ] && CHAIN="$CHAIN,scale=$WIDTH:-2"
+FILTER="$FILTER;[dns]$CHAIN[top]"
+
+# Stacks the graphs underneath
+if [ ${#GRAPHS[@]} -gt 0 ]; then
+    STACK="[top]"
+    for ((k = 0; k < ${#GRAPHS[@]}; k++))
+    do
+        CHAIN=${GRAPH_FILTERS[$k]}
+        [ -n "$WIDTH" ] && CHAIN="$CHAIN,scale=$WIDTH:-2"
+        FILTER="$FILTER;[$((RUN_NO + k)):v]$CHAIN[graph$k]"
+        STACK="$STACK[graph$k]"
+    done
+    FILTER="$FILTER;${STACK}vstack=inputs=$((${#GRAPHS[@]} + 1)),setsar=1[out]"
+else
+    FILTER="$FILTER;[top]setsar=1[out]"
+fi
+
+ffmpeg -y -loglevel error "${INPUTS[@]}" -filter_complex "$FILTER" \
+    -map "[out]" -c:v libx264 -crf 18 -pix_fmt yuv420p $OUTPUT
@@ -2,34 +2,20 @@
 
 # Script to combine the video of the DNS pressure alongside a moving graph
 # outputted from MATLAB. The MATLAB graph will be in the video
-# pressure_overlay.avi, which needs to be padded and resolution changed in order
-# to fit underneath the DNS video combined_pressure.mp4. The final video will be
-# called pressure_with_graph.mp4
+# pressure_overlay.avi, which is cropped and scaled to fit underneath the 
+# padded DNS video combined_pressure.mp4. This is done in a single pass with 
+# compose_frames.sh, so the videos are only encoded once. The final video will
+# be called pressure_with_graph.mp4
 
 OVERLAY=$1
 DNS=$2
 RESULT=$3
 HEIGHT=$4
 
-# Crops the scaled pressure video
-ffmpeg -y -i $OVERLAY -filter:v "crop=1516:$HEIGHT:170:$HEIGHT" cropped_pressure.mp4
+SCRIPT_DIR=$(dirname $(realpath $0))
 
-# Rescale the cropped pressure video
-ffmpeg -y -i cropped_pressure.mp4 -vf scale=2048:-1 graph_pressure.mp4
-
-# Pads the DNS video
-ffmpeg -y -i $DNS -vf "pad=width=2176:height=1152:x=103:y=0:color=white" padded_dns.mp4
-# ffmpeg -y -i $DNS -vf "pad=width=2176:height=1024:x=103:y=0:color=white" padded_dns.mp4
-
-# Rescales DNS video
-ffmpeg -y -i padded_dns.mp4 -vf scale=2048:-1 scaled_dns.mp4
-
-# # # Combine videos
-ffmpeg -y -i scaled_dns.mp4 -i graph_pressure.mp4 -filter_complex vstack \
-   $RESULT
-
-# # Remove videos
-rm padded_dns.mp4
-rm scaled_dns.mp4
-rm cropped_pressure.mp4
-rm graph_pressure.mp4
+# Pads the DNS video, crops the graph and scales both to the same width
+$SCRIPT_DIR/compose_frames.sh -w 2048 \
+    -p "width=2176:height=1152:x=103:y=0:color=white" \
+    -g $OVERLAY -c "crop=1516:$HEIGHT:170:$HEIGHT" \
+    $RESULT $DNS
@@ -1,5 +1,8 @@
 #!/bin/bash
 
+# Combines the DNS videos with the graph overlay, with the variants run in
+# parallel
+
 MAINDIR=/home/michael/Documents/supplementary_material/dns_videos
 OVERLAY=$MAINDIR/pressure_overlays/pressure_overlay.avi
 HEIGHT=250
@@ -12,5 +15,6 @@ do
     DNS=$MAINDIR/pressure_with_bar.mp4
     # RES=$MAINDIR/dns_with_graphs/pressure_${COEFF}_overlay_height_257_max_3.mp4
     RES=$MAINDIR/pressure_with_graph.mp4
-    ./dns_graph_combined.sh $OVERLAY $DNS $RES $HEIGHT
+    ./dns_graph_combined.sh $OVERLAY $DNS $RES $HEIGHT &
 done
+wait
@@ -1,24 +1,16 @@
 #!/bin/bash
 
-# Script to combine two videos outputted from DNS of the pressure
-# Assumes in the current directory there are the videos:
+# Script to combine two videos outputted from DNS of the pressure, with the
+# stationary case on the left (mirrored) and moving on the right, in a single
+# pass using compose_frames.sh. The inputs are the stationary and moving videos
+# (or directories of frames from render_movie.sh) and the combined video.
 #
-# stationary.mp4 (Video from stationary plate case)
-# moving.mp4 (Video from moving plate case)
-#
-# Subsequently produces dns_pressure.mp4, a video with the
-# stationary case on the left and moving on the right
+# ./dns_snapshot.sh stationary.mp4 moving.mp4 dns_pressure.mp4
 
 STATIONARY=$1
 MOVING=$2
 FINAL=$3
 
-# Flips the stationary pressure
-ffmpeg -i $STATIONARY -vf hflip -c:a copy stationary_mirrored.mp4
-
-# Combines mirrored stationary and moving 
-ffmpeg -i stationary_mirrored.mp4 -i $MOVING -filter_complex hstack \
-    $FINAL
+SCRIPT_DIR=$(dirname $(realpath $0))
 
-# Removes the mirrored video
-rm stationary_mirrored.mp4
+$SCRIPT_DIR/compose_frames.sh $FINAL $STATIONARY $MOVING
@@ -0,0 +1,360 @@
+/* movie_renderer.c
+    Offline renderer for the movie snapshots saved by droplet_impact_plate.c 
+    with MOVIE_SNAPSHOTS = 1. Each snapshot is restored and rendered with 
+    bview, using the same view as the movies event of the simulation, into a
+    PPM frame. Any of the saved fields can be rendered with any colour map and
+    range, so movies can be re-coloured without re-running the simulation. 
+    The frames are assembled into a movie by render_movie.sh, which runs many
+    renderers in parallel.
+
+    Usage:
+    ./movie_renderer [options] SNAPSHOT ...
+    Options:
+    -o DIR          Directory to write the frames to (default .)
+    -f FIELD        Field to render, one of f, p, u.x, u.y or u.norm (default p)
+    -min VALUE      Minimum of the colour range
+    -max VALUE      Maximum of the colour range (default is the range of the 
+                    field in each frame)
+    -wagner COEFF   After impact, sets the range to [0, COEFF * pmax], where 
+                    pmax is the Wagner theory maximum pressure for a 
+                    stationary plate (as the pressure movies of the simulation)
+    -impact TIME    Impact time, for the Wagner scaling (default 0.125)
+    -map MAP        Colour map, one of cool_warm, jet or gray (default 
+                    cool_warm)
+    -size PIXELS    Width and height of the frames (default 1024)
+    -time           Writes the time on the frames
+    -plots          Adds a panel of plots underneath each frame, synchronised
+                    with the frame: the force and s against t (from the log in
+                    the directory of the snapshots) and the pressure along the
+                    plate
+    -axi            The run is axisymmetric (AXISYMMETRIC = 1), so the force 
+                    and pressure plots are compared against the Wagner theory
+                    composite solution for the plate motion, which is only
+                    available for the axisymmetric geometry
+    -log FILE       Log file to plot from (default the log in the directory of
+                    the first snapshot)
+    The frame of snapshot_N is written to DIR/frame_N.ppm, with N padded to
+    five digits.
+*/
+
+#include "utils.h"
+#include "fractions.h"
+#include "view.h"
+#include "wagner.h"
+#include "plot_overlay.h"
+
+scalar f[], p[];
+vector u[];
+
+/* Time series read from the log, with the Wagner force for the plate motion 
+(NULL unless the run is axisymmetric) */
+typedef struct {
+    double * t, * F, * s, * ds_dt, * d2s_dt2, * wagner_F;
+    int n;
+} log_series;
+
+/* Reads the force and plate motion from the log of a run, either raw or
+cleaned */
+int read_log(const char * filename, log_series * log) {
+    FILE * fp = fopen(filename, "r");
+    if (fp == NULL) return -1;
+    int capacity = 0;
+    log->n = 0;
+    char line[1024];
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        double t, F, force_term, avg, std, s, ds_dt, d2s_dt2;
+        if ((sscanf(line, "t = %lf, F = %lf, force_term = %lf, avg = %lf, std = %lf, s = %lf, ds_dt = %lf, d2s_dt2 = %lf", \
+                &t, &F, &force_term, &avg, &std, &s, &ds_dt, &d2s_dt2) != 8) \
+            && (sscanf(line, "%lf, %lf, %lf, %lf, %lf, %lf, %lf, %lf", \
+                &t, &F, &force_term, &avg, &std, &s, &ds_dt, &d2s_dt2) != 8)) {
+            continue;
+        }
+        if (log->n == capacity) {
+            capacity = capacity ? 2 * capacity : 1024;
+            log->t = realloc(log->t, capacity * sizeof(double));
+            log->F = realloc(log->F, capacity * sizeof(double));
+            log->s = realloc(log->s, capacity * sizeof(double));
+            log->ds_dt = realloc(log->ds_dt, capacity * sizeof(double));
+            log->d2s_dt2 = realloc(log->d2s_dt2, capacity * sizeof(double));
+        }
+        log->t[log->n] = t;
+        log->F[log->n] = F;
+        log->s[log->n] = s;
+        log->ds_dt[log->n] = ds_dt;
+        log->d2s_dt2[log->n] = d2s_dt2;
+        log->n++;
+    }
+    fclose(fp);
+    return 0;
+}
+
+/* Computes the Wagner force for the plate motion of the log, for an 
+axisymmetric run */
+void wagner_force_series(log_series * log, double impact_time) {
+    log->wagner_F = malloc(log->n * sizeof(double));
+    for (int k = 0; k < log->n; k++) {
+        log->wagner_F[k] = wagner_composite_force(log->t[k] - impact_time, \
+            log->s[k], log->ds_dt[k], log->d2s_dt2[k], 1.);
+    }
+}
+
+/* Value of one of the series of the log at the time t, linearly interpolated */
+double log_interpolate(const log_series * log, const double * values, \
+        double t) {
+    for (int k = 1; k < log->n; k++) {
+        if (log->t[k] >= t) {
+            double w = (t - log->t[k - 1]) / (log->t[k] - log->t[k - 1]);
+            return (1. - w) * values[k - 1] + w * values[k];
+        }
+    }
+    return log->n > 0 ? values[log->n - 1] : 0.;
+}
+
+/* Range of the values with times in [t_start, t_end], padded by 10% */
+void series_range(const double * ts, const double * values, int n, \
+        double t_start, double t_end, double * low, double * high) {
+    *low = HUGE;
+    *high = - HUGE;
+    for (int k = 0; k < n; k++) {
+        if ((ts[k] < t_start) || (ts[k] > t_end)) continue;
+        if (!isfinite(values[k])) continue;
+        *low = fmin(*low, values[k]);
+        *high = fmax(*high, values[k]);
+    }
+    if (*low > *high) *low = *high = 0.;
+    double pad = 0.1 * (*high - *low) + 1e-12;
+    *low -= pad;
+    *high += pad;
+}
+
+static int compare_first(const void * a, const void * b) {
+    double difference = ((const double *) a)[0] - ((const double *) b)[0];
+    return (difference > 0.) - (difference < 0.);
+}
+
+/* Draws the panel of plots underneath the frame saved in frame_filename */
+void draw_plots(const char * frame_filename, const log_series * log, \
+        double impact_time, int size) {
+    int panel_height = (size / 3) & ~1; // Even, for the video encoder
+    canvas c;
+    if (canvas_read_ppm(frame_filename, panel_height, &c) < 0) return;
+
+    int scale = size >= 512 ? size / 512 : 1;
+    int margin = size / 24;
+    int plot_width = (size - 4 * margin) / 3;
+    int plot_height = panel_height - 2 * margin;
+    int y0 = size + margin;
+    double t_end = log->n > 0 ? log->t[log->n - 1] : t;
+
+    /* Force against time, compared with Wagner theory if axisymmetric */
+    plot_axes force_axes = {margin, y0, plot_width, plot_height, 0., t_end};
+    series_range(log->t, log->F, log->n, impact_time + 0.01, t_end, \
+        &force_axes.ymin, &force_axes.ymax);
+    force_axes.ymin = fmin(force_axes.ymin, 0.);
+    plot_frame(&c, &force_axes, "F", scale);
+    if (log->wagner_F != NULL) {
+        plot_series(&c, &force_axes, log->t, log->wagner_F, log->n, t, \
+            plot_red, scale);
+    }
+    plot_series(&c, &force_axes, log->t, log->F, log->n, t, plot_blue, scale);
+    plot_marker(&c, &force_axes, t, plot_grey);
+
+    /* Plate position against time */
+    plot_axes s_axes = {2 * margin + plot_width, y0, plot_width, plot_height, \
+        0., t_end};
+    series_range(log->t, log->s, log->n, 0., t_end, &s_axes.ymin, \
+        &s_axes.ymax);
+    plot_frame(&c, &s_axes, "s", scale);
+    plot_series(&c, &s_axes, log->t, log->s, log->n, t, plot_blue, scale);
+    plot_marker(&c, &s_axes, t, plot_grey);
+
+    /* Pressure along the plate, sorted by the radial position */
+    int cell_no = 0;
+    foreach_boundary(left) {
+        cell_no++;
+    }
+    double * profile = malloc(2 * cell_no * sizeof(double));
+    int k = 0;
+    foreach_boundary(left) {
+        profile[2 * k] = y;
+        profile[2 * k + 1] = p[];
+        k++;
+    }
+    qsort(profile, cell_no, 2 * sizeof(double), compare_first);
+    double * rs = malloc(3 * cell_no * sizeof(double));
+    double * ps = rs + cell_no, * wagner_ps = rs + 2 * cell_no;
+    double s = log_interpolate(log, log->s, t);
+    double sdot = log_interpolate(log, log->ds_dt, t);
+    double sddot = log_interpolate(log, log->d2s_dt2, t);
+    bool wagner = (log->wagner_F != NULL);
+    for (k = 0; k < cell_no; k++) {
+        rs[k] = profile[2 * k];
+        ps[k] = profile[2 * k + 1];
+        if (wagner) {
+            wagner_ps[k] = wagner_composite_pressure(rs[k], t - impact_time, \
+                s, sdot, sddot, 1.);
+        }
+    }
+
+    double r_max = 1.5;
+    plot_axes p_axes = {3 * margin + 2 * plot_width, y0, plot_width, \
+        plot_height, 0., r_max, 0., 1.};
+    if (wagner && (t > impact_time)) {
+        p_axes.ymax = 1.5 * wagner_pmax(t - impact_time, s, sdot, 1.);
+    } else {
+        series_range(rs, ps, cell_no, 0., r_max, &p_axes.ymin, &p_axes.ymax);
+    }
+    plot_frame(&c, &p_axes, "p", scale);
+    if (wagner) {
+        plot_series(&c, &p_axes, rs, wagner_ps, cell_no, r_max, plot_red, \
+            scale);
+    }
+    plot_series(&c, &p_axes, rs, ps, cell_no, r_max, plot_blue, scale);
+
+    canvas_write_ppm(frame_filename, &c);
+    free(rs);
+    free(profile);
+    free(c.rgb);
+}
+
+int main(int argc, char * argv[]) {
+    /* Default options */
+    char * output_dir = ".";
+    char * field = "p";
+    double min = 0., max = 0.;
+    bool fixed_range = false;
+    double wagner_coeff = 0.;
+    double impact_time = 0.125;
+    Colormap map = cool_warm;
+    int size = 1024;
+    bool draw_time = false;
+    bool plots = false;
+    bool axisymmetric = false;
+    char * log_filename = NULL;
+
+    /* Reads the options, where anything else is a snapshot */
+    char ** snapshots = malloc(argc * sizeof(char *));
+    int snapshot_no = 0;
+    for (int k = 1; k < argc; k++) {
+        if (!strcmp(argv[k], "-o") && k + 1 < argc) {
+            output_dir = argv[++k];
+        } else if (!strcmp(argv[k], "-f") && k + 1 < argc) {
+            field = argv[++k];
+        } else if (!strcmp(argv[k], "-min") && k + 1 < argc) {
+            min = atof(argv[++k]);
+            fixed_range = true;
+        } else if (!strcmp(argv[k], "-max") && k + 1 < argc) {
+            max = atof(argv[++k]);
+            fixed_range = true;
+        } else if (!strcmp(argv[k], "-wagner") && k + 1 < argc) {
+            wagner_coeff = atof(argv[++k]);
+        } else if (!strcmp(argv[k], "-impact") && k + 1 < argc) {
+            impact_time = atof(argv[++k]);
+        } else if (!strcmp(argv[k], "-map") && k + 1 < argc) {
+            k++;
+            if (!strcmp(argv[k], "jet")) map = jet;
+            else if (!strcmp(argv[k], "gray")) map = gray;
+            else map = cool_warm;
+        } else if (!strcmp(argv[k], "-size") && k + 1 < argc) {
+            size = atoi(argv[++k]);
+        } else if (!strcmp(argv[k], "-time")) {
+            draw_time = true;
+        } else if (!strcmp(argv[k], "-plots")) {
+            plots = true;
+        } else if (!strcmp(argv[k], "-axi")) {
+            axisymmetric = true;
+        } else if (!strcmp(argv[k], "-log") && k + 1 < argc) {
+            log_filename = argv[++k];
+        } else {
+            snapshots[snapshot_no++] = argv[k];
+        }
+    }
+
+    /* Reads the log for the plots, which by default is in the same directory
+    as the snapshots */
+    log_series log = {NULL, NULL, NULL, NULL, NULL, NULL, 0};
+    if (plots && snapshot_no > 0) {
+        char default_log[1024];
+        if (log_filename == NULL) {
+            const char * slash = strrchr(snapshots[0], '/');
+            int length = slash != NULL ? slash - snapshots[0] + 1 : 0;
+            snprintf(default_log, sizeof(default_log), "%.*slog", length, \
+                snapshots[0]);
+            log_filename = default_log;
+        }
+        if (read_log(log_filename, &log) < 0) {
+            fprintf(stderr, "Could not read %s, no plots drawn\n", \
+                log_filename);
+            plots = false;
+        } else if (axisymmetric) {
+            wagner_force_series(&log, impact_time);
+        }
+    }
+
+    init_grid(1);
+    scalar speed[]; // Norm of the velocity, for u.norm
+
+    for (int k = 0; k < snapshot_no; k++) {
+        if (!restore(file = snapshots[k], list = (scalar *){f, p, u})) {
+            fprintf(stderr, "Could not restore %s\n", snapshots[k]);
+            continue;
+        }
+
+        char * name = field;
+        if (!strcmp(field, "u.norm")) {
+            foreach() {
+                speed[] = sqrt(sq(u.x[]) + sq(u.y[]));
+            }
+            boundary({speed});
+            name = "speed";
+        }
+
+        /* Colour range, which is fixed, scaled by the Wagner maximum pressure
+        or the range of the field */
+        bool set_range = fixed_range;
+        double frame_min = min, frame_max = max;
+        if ((wagner_coeff > 0.) && (t > impact_time)) {
+            frame_min = 0.;
+            frame_max = wagner_coeff * wagner_pmax(t - impact_time, 0., 0., 1.);
+            set_range = true;
+        }
+
+        view (width = size, height = size, fov = 9, ty = -0.235, \
+            tx = -0.235, quat = {0, 0, -0.707, 0.707});
+        clear();
+        mirror({0, 1}) {
+            draw_vof("f", lw = 2);
+            if (set_range) {
+                squares(name, min = frame_min, max = frame_max, \
+                    linear = true, spread = -1, map = map);
+            } else {
+                squares(name, linear = true, spread = -1, map = map);
+            }
+        }
+        if (draw_time) {
+            char time_str[80];
+            sprintf(time_str, "t = %g\n", t);
+            draw_string(time_str, pos = 1, lc = {0, 0, 0}, lw = 2);
+        }
+
+        /* The frame number is taken from the snapshot name */
+        const char * suffix = strrchr(snapshots[k], '_');
+        int frame = suffix != NULL ? atoi(suffix + 1) : k;
+        char frame_filename[1024];
+        snprintf(frame_filename, sizeof(frame_filename), "%s/frame_%05d.ppm", \
+            output_dir, frame);
+        save(frame_filename);
+
+        if (plots) {
+            draw_plots(frame_filename, &log, impact_time, size);
+        }
+    }
+
+    free(log.t);
+    free(log.F);
+    free(log.s);
+    free(log.ds_dt);
+    free(log.d2s_dt2);
+    free(log.wagner_F);
+    free(snapshots);
+}
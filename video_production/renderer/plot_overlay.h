@@ -0,0 +1,224 @@
+/* plot_overlay.h
+    Minimal line plots drawn directly into the RGB frames of movie_renderer.c,
+    so time series can be added to the movies without a separate graph video.
+    Frames are read and written as binary PPM files (as saved by bview), lines
+    are drawn with Bresenham's algorithm and numbers with a 5x7 bitmap font.
+    Plain C, with no dependencies beyond the standard library.
+*/
+
+#ifndef PLOT_OVERLAY_H
+#define PLOT_OVERLAY_H
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* RGB image, stored row by row from the top left */
+typedef struct {
+    unsigned char * rgb;
+    int width, height;
+} canvas;
+
+/* Region of a canvas in pixels, and the data ranges it shows */
+typedef struct {
+    int x0, y0, width, height;
+    double xmin, xmax, ymin, ymax;
+} plot_axes;
+
+typedef struct {
+    unsigned char r, g, b;
+} colour;
+
+static const colour plot_black = {0, 0, 0};
+static const colour plot_grey = {170, 170, 170};
+static const colour plot_blue = {31, 119, 180};
+static const colour plot_red = {214, 39, 40};
+
+/* Reads a binary PPM file into a canvas with extra_height white rows added
+underneath. Returns 0 on success and -1 if the file could not be read */
+int canvas_read_ppm(const char * filename, int extra_height, canvas * c) {
+    FILE * fp = fopen(filename, "rb");
+    if (fp == NULL) return -1;
+    int max_value;
+    if (fscanf(fp, "P6 %d %d %d", &c->width, &c->height, &max_value) != 3) {
+        fclose(fp);
+        return -1;
+    }
+    fgetc(fp); // Single whitespace character after the header
+    size_t frame_size = (size_t) 3 * c->width * c->height;
+    c->rgb = malloc(frame_size + (size_t) 3 * c->width * extra_height);
+    if (fread(c->rgb, 1, frame_size, fp) != frame_size) {
+        fclose(fp);
+        free(c->rgb);
+        return -1;
+    }
+    fclose(fp);
+    memset(c->rgb + frame_size, 255, (size_t) 3 * c->width * extra_height);
+    c->height += extra_height;
+    return 0;
+}
+
+int canvas_write_ppm(const char * filename, const canvas * c) {
+    FILE * fp = fopen(filename, "wb");
+    if (fp == NULL) return -1;
+    fprintf(fp, "P6\n%d %d\n255\n", c->width, c->height);
+    fwrite(c->rgb, 1, (size_t) 3 * c->width * c->height, fp);
+    fclose(fp);
+    return 0;
+}
+
+static void set_pixel(canvas * c, int x, int y, colour col) {
+    if (x < 0 || y < 0 || x >= c->width || y >= c->height) return;
+    unsigned char * pixel = &c->rgb[3 * ((size_t) y * c->width + x)];
+    pixel[0] = col.r;
+    pixel[1] = col.g;
+    pixel[2] = col.b;
+}
+
+/* Line from (x0, y0) to (x1, y1) using Bresenham's algorithm, thickened to a
+square of thickness pixels */
+void draw_line(canvas * c, int x0, int y0, int x1, int y1, colour col, \
+        int thickness) {
+    int dx = abs(x1 - x0), dy = - abs(y1 - y0);
+    int sx = x0 < x1 ? 1 : -1, sy = y0 < y1 ? 1 : -1;
+    int error = dx + dy;
+    while (1) {
+        for (int i = 0; i < thickness; i++) {
+            for (int j = 0; j < thickness; j++) {
+                set_pixel(c, x0 + i - thickness / 2, y0 + j - thickness / 2, \
+                    col);
+            }
+        }
+        if (x0 == x1 && y0 == y1) break;
+        int e2 = 2 * error;
+        if (e2 >= dy) {
+            error += dy;
+            x0 += sx;
+        }
+        if (e2 <= dx) {
+            error += dx;
+            y0 += sy;
+        }
+    }
+}
+
+/* 5x7 bitmap font for the characters needed for axis labels. Each row is a
+byte, with the leftmost pixel in the highest of the five bits */
+static const char font_characters[] = "0123456789.-+eFsptrW=";
+static const unsigned char font_glyphs[][7] = {
+    {14, 17, 19, 21, 25, 17, 14}, // 0
+    {4, 12, 4, 4, 4, 4, 14}, // 1
+    {14, 17, 1, 2, 4, 8, 31}, // 2
+    {31, 2, 4, 2, 1, 17, 14}, // 3
+    {2, 6, 10, 18, 31, 2, 2}, // 4
+    {31, 16, 30, 1, 1, 17, 14}, // 5
+    {6, 8, 16, 30, 17, 17, 14}, // 6
+    {31, 1, 2, 4, 8, 8, 8}, // 7
+    {14, 17, 17, 14, 17, 17, 14}, // 8
+    {14, 17, 17, 15, 1, 2, 12}, // 9
+    {0, 0, 0, 0, 0, 12, 12}, // .
+    {0, 0, 0, 31, 0, 0, 0}, // -
+    {0, 4, 4, 31, 4, 4, 0}, // +
+    {0, 0, 14, 17, 31, 16, 14}, // e
+    {31, 16, 16, 30, 16, 16, 16}, // F
+    {0, 0, 15, 16, 14, 1, 30}, // s
+    {0, 0, 30, 17, 30, 16, 16}, // p
+    {8, 8, 28, 8, 8, 9, 6}, // t
+    {0, 0, 22, 25, 16, 16, 16}, // r
+    {17, 17, 17, 21, 21, 21, 10}, // W
+    {0, 0, 31, 0, 31, 0, 0}, // =
+};
+
+/* Writes text with its top left corner at (x, y), with each font pixel
+drawn as a square of scale pixels. Unknown characters are left blank */
+void draw_text(canvas * c, int x, int y, const char * text, colour col, \
+        int scale) {
+    for (int k = 0; text[k] != '\0'; k++) {
+        const char * found = strchr(font_characters, text[k]);
+        if (found != NULL && text[k] != '\0') {
+            const unsigned char * glyph \
+                = font_glyphs[found - font_characters];
+            for (int row = 0; row < 7; row++) {
+                for (int column = 0; column < 5; column++) {
+                    if (!(glyph[row] & (16 >> column))) continue;
+                    for (int i = 0; i < scale; i++) {
+                        for (int j = 0; j < scale; j++) {
+                            set_pixel(c, x + column * scale + i, \
+                                y + row * scale + j, col);
+                        }
+                    }
+                }
+            }
+        }
+        x += 6 * scale;
+    }
+}
+
+/* Pixel coordinates of a data point */
+static int plot_x(const plot_axes * a, double x) {
+    return a->x0 + (int) lround((x - a->xmin) / (a->xmax - a->xmin) \
+        * (a->width - 1));
+}
+
+static int plot_y(const plot_axes * a, double y) {
+    return a->y0 + a->height - 1 - (int) lround((y - a->ymin) \
+        / (a->ymax - a->ymin) * (a->height - 1));
+}
+
+/* Draws the box of the axes, the zero line if it is in range, the data ranges
+at the corners and the label at the top left */
+void plot_frame(canvas * c, const plot_axes * a, const char * label, \
+        int scale) {
+    int x1 = a->x0 + a->width - 1, y1 = a->y0 + a->height - 1;
+    draw_line(c, a->x0, a->y0, x1, a->y0, plot_black, 1);
+    draw_line(c, a->x0, y1, x1, y1, plot_black, 1);
+    draw_line(c, a->x0, a->y0, a->x0, y1, plot_black, 1);
+    draw_line(c, x1, a->y0, x1, y1, plot_black, 1);
+    if (a->ymin < 0. && a->ymax > 0.) {
+        draw_line(c, a->x0, plot_y(a, 0.), x1, plot_y(a, 0.), plot_grey, 1);
+    }
+
+    char text[32];
+    int gap = 2 * scale, character_height = 7 * scale;
+    snprintf(text, sizeof(text), "%.3g", a->ymax);
+    draw_text(c, a->x0 + gap, a->y0 + gap, text, plot_black, scale);
+    snprintf(text, sizeof(text), "%.3g", a->ymin);
+    draw_text(c, a->x0 + gap, y1 - gap - character_height, text, \
+        plot_black, scale);
+    snprintf(text, sizeof(text), "%.3g", a->xmin);
+    draw_text(c, a->x0, y1 + gap, text, plot_black, scale);
+    snprintf(text, sizeof(text), "%.3g", a->xmax);
+    draw_text(c, x1 - 6 * scale * (int) strlen(text), y1 + gap, text, \
+        plot_black, scale);
+    draw_text(c, a->x0 + a->width / 2 - 3 * scale * (int) strlen(label), \
+        a->y0 - gap - character_height, label, plot_black, scale);
+}
+
+/* Draws the points (xs[k], ys[k]) with xs[k] <= x_end joined by lines,
+clipped to the axes */
+void plot_series(canvas * c, const plot_axes * a, const double * xs, \
+        const double * ys, int n, double x_end, colour col, int thickness) {
+    int started = 0, px_previous = 0, py_previous = 0;
+    for (int k = 0; k < n; k++) {
+        if (xs[k] > x_end) break;
+        if (!isfinite(ys[k])) continue;
+        double y = fmin(fmax(ys[k], a->ymin), a->ymax);
+        int px = plot_x(a, xs[k]), py = plot_y(a, y);
+        if (started) {
+            draw_line(c, px_previous, py_previous, px, py, col, thickness);
+        }
+        started = 1;
+        px_previous = px;
+        py_previous = py;
+    }
+}
+
+/* Vertical marker at x, e.g. the current time */
+void plot_marker(canvas * c, const plot_axes * a, double x, colour col) {
+    if (x < a->xmin || x > a->xmax) return;
+    draw_line(c, plot_x(a, x), a->y0, plot_x(a, x), a->y0 + a->height - 1, \
+        col, 1);
+}
+
+#endif
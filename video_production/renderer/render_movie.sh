@@ -0,0 +1,46 @@
+#!/bin/bash
+
+# render_movie.sh
+# Renders a movie from the snapshots of a run (saved with MOVIE_SNAPSHOTS = 1)
+# using movie_renderer, with the frames rendered in parallel and encoded once
+# with ffmpeg. It takes the inputs:
+# Input 1: Directory containing the snapshot_N files (e.g. raw_data)
+# Input 2: Name of the movie to produce (e.g. pressure.mp4)
+# Input 3: Number of renderers to run in parallel (default 1)
+# Any further inputs are passed to movie_renderer, e.g.
+# ./render_movie.sh raw_data pressure_1.3.mp4 8 -f p -wagner 1.3 -time
+# The frames are deleted afterwards, unless FRAMES_DIR is set, in which case
+# they are kept in that directory (e.g. for compose_frames.sh).
+
+SNAPSHOT_DIR=$1
+MOVIE=$2
+CORES=${3:-1}
+shift $(( $# < 3 ? $# : 3 ))
+OPTIONS=("$@")
+
+SCRIPT_DIR=$(dirname $(realpath $0))
+FRAMERATE=${FRAMERATE:-25}
+
+if [ -n "$FRAMES_DIR" ]; then
+    mkdir -p $FRAMES_DIR
+    OUTPUT_DIR=$FRAMES_DIR
+else
+    OUTPUT_DIR=$(mktemp -d)
+fi
+
+# Snapshots in order, split evenly between the renderers so each renderer only
+# starts once
+SNAPSHOTS=$(ls -v $SNAPSHOT_DIR/snapshot_*)
+SNAPSHOT_NO=$(echo "$SNAPSHOTS" | wc -l)
+CHUNK=$(( (SNAPSHOT_NO + CORES - 1) / CORES ))
+
+echo "$SNAPSHOTS" | xargs -P $CORES -n $CHUNK \
+    $SCRIPT_DIR/movie_renderer -o $OUTPUT_DIR "${OPTIONS[@]}"
+
+# Encodes the frames once. The frame numbers start from 0
+ffmpeg -y -loglevel error -framerate $FRAMERATE \
+    -i $OUTPUT_DIR/frame_%05d.ppm -c:v libx264 -pix_fmt yuv420p -crf 18 $MOVIE
+
+if [ -z "$FRAMES_DIR" ]; then
+    rm -rf $OUTPUT_DIR
+fi